@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "counters.hpp"
+#include "kmer_entry.hpp"
+#include "kmer_run.hpp"
+#include "kmer_t.hpp"
+#include "shared_slots.hpp"
+#include "trace.hpp"
+
+// Number of one-sided inserts each thread keeps outstanding
+#define MAX_INSERTS_IN_FLIGHT 1024
+
+// Key words fetched per probe step: one cache line
+#define PROBE_WINDOW 8
+
+// Inserts and finds with remote atomics and rget/rput alone, so the owner
+// never runs a handler: an insert CASes a key word of the owner's
+// SharedSlots, and a find fetches the key words a cache line at a time and
+// scans them here. Without the owner's help a find cannot follow the
+// contig, so every run it returns is one k-mer long.
+template <typename Map> struct AtomicTransport {
+    // Inserts started by one thread and not yet landed
+    struct SendBuffers {
+        int in_flight;
+        bool failed;
+
+        SendBuffers() : in_flight(0), failed(false) {}
+    };
+
+    Map& map;
+
+    upcxx::atomic_domain<uint64_t> ad;
+
+    // Where this rank's arrays are, and every rank's, fetched once so
+    // inserts never wait on a lookup
+    upcxx::dist_object<SharedSlots::Pointers> arrays_g;
+    std::vector<SharedSlots::Pointers> partitions;
+
+    // Slots per partition, the same on every rank
+    size_t n_slots;
+
+    AtomicTransport(Map& map1);
+    ~AtomicTransport();
+
+    // Start a k-mer's insert; flush() waits for it and reports whether it fit
+    bool insert(const kmer_pair& kmer, uint64_t hash, int owner, SendBuffers& buffers);
+    bool flush(SendBuffers& buffers);
+
+    upcxx::future<kmer_run> find(const pkmer_t& key_kmer, uint64_t hash, int owner, int depth);
+
+    // Try to claim slot, moving on to the next one until probe reaches n_slots
+    upcxx::future<bool> claim_slot(const kmer_pair& kmer, uint64_t word, int owner, size_t slot,
+                                   size_t probe);
+
+    // Scan the key words from slot to the end of its cache line, and the
+    // lines after it until the k-mer or an empty slot turns up
+    upcxx::future<kmer_run> probe_slots(const pkmer_t& key_kmer, uint64_t key, int owner,
+                                        size_t slot, size_t probe);
+
+    // Read the k-mer in a slot whose key word matched, and go on probing
+    // if the key word was only a fingerprint of another k-mer
+    upcxx::future<kmer_run> read_slot(const pkmer_t& key_kmer, uint64_t key, uint64_t word,
+                                      int owner, size_t slot, size_t probe);
+};
+
+// The owner cleared its key words before it published where they are, so
+// no insert can reach a partition too early
+template <typename Map>
+AtomicTransport<Map>::AtomicTransport(Map& map1)
+    : map(map1), ad({upcxx::atomic_op::compare_exchange}), arrays_g(map1.local.arrays),
+      n_slots(map1.local.capacity()) {
+    static_assert(std::is_same<typename Map::storage_type, SharedSlots>::value,
+                  "AtomicTransport needs SharedSlots storage");
+
+    partitions.resize(upcxx::rank_n());
+    for (int i = 0; i < upcxx::rank_n(); i++) {
+        partitions[i] = arrays_g.fetch(i).wait();
+    }
+}
+
+template <typename Map> AtomicTransport<Map>::~AtomicTransport() {
+    // Need to destroy the atomic domain when the hashmap is destroyed
+    ad.destroy();
+}
+
+template <typename Map>
+bool AtomicTransport<Map>::insert(const kmer_pair& kmer, uint64_t hash, int owner,
+                                  SendBuffers& buffers) {
+    buffers.in_flight++;
+    claim_slot(kmer, SharedSlots::slot_word(kmer), owner, map.local.first_slot(hash), 0)
+        .then([&buffers](bool inserted) {
+            if (!inserted) {
+                buffers.failed = true;
+            }
+            buffers.in_flight--;
+        });
+
+    if (buffers.in_flight >= MAX_INSERTS_IN_FLIGHT) {
+        TRACE_SPAN("wait for inserts");
+        while (buffers.in_flight >= MAX_INSERTS_IN_FLIGHT) {
+            upcxx::progress();
+        }
+    }
+    return true;
+}
+
+template <typename Map> bool AtomicTransport<Map>::flush(SendBuffers& buffers) {
+    TRACE_SPAN("drain inserts");
+    while (buffers.in_flight > 0) {
+        upcxx::progress();
+    }
+    return !buffers.failed;
+}
+
+template <typename Map>
+upcxx::future<bool> AtomicTransport<Map>::claim_slot(const kmer_pair& kmer, uint64_t word,
+                                                     int owner, size_t slot, size_t probe) {
+    const SharedSlots::Pointers& arrays = partitions[owner];
+    COUNT(counters().count_rpc(owner, sizeof(uint64_t)));
+
+    // A single remote CAS both claims the slot and publishes the key
+    return ad.compare_exchange(arrays.keys + slot, 0, word, std::memory_order_relaxed)
+        .then([this, kmer, word, owner, slot, probe](uint64_t previous) {
+            if (previous == 0) {
+                if (SharedSlots::entry_in_key_word()) {
+                    return upcxx::make_future(true);
+                }
+                const SharedSlots::Pointers& arrays = partitions[owner];
+                uint16_t ext;
+                memcpy(&ext, kmer.fb_ext, 2);
+                upcxx::future<> stored = upcxx::rput(ext, arrays.exts + slot);
+                if (!SharedSlots::key_word_exact()) {
+                    stored = upcxx::when_all(stored, upcxx::rput(kmer.kmer, arrays.kmers + slot));
+                }
+                return stored.then([]() { return true; });
+            }
+            if (probe + 1 >= n_slots) {
+                return upcxx::make_future(false);
+            }
+            return claim_slot(kmer, word, owner, (slot + 1) % n_slots, probe + 1);
+        });
+}
+
+template <typename Map>
+upcxx::future<kmer_run> AtomicTransport<Map>::find(const pkmer_t& key_kmer, uint64_t hash,
+                                                   int owner, int) {
+    return probe_slots(key_kmer, SharedSlots::probe_key(key_kmer), owner,
+                       map.local.first_slot(hash), 0);
+}
+
+template <typename Map>
+upcxx::future<kmer_run> AtomicTransport<Map>::probe_slots(const pkmer_t& key_kmer, uint64_t key,
+                                                          int owner, size_t slot, size_t probe) {
+    size_t line_end = std::min<size_t>(slot - slot % PROBE_WINDOW + PROBE_WINDOW, n_slots);
+    size_t n = std::min(line_end - slot, n_slots - probe);
+
+    // The window lives until the scan below has run
+    auto window = std::make_shared<std::array<uint64_t, PROBE_WINDOW>>();
+    return upcxx::rget(partitions[owner].keys + slot, window->data(), n)
+        .then([this, key_kmer, key, owner, slot, probe, n, window]() {
+            for (size_t i = 0; i < n; i++) {
+                uint64_t word = (*window)[i];
+
+                // Nothing is ever removed, so an empty slot ends the probe sequence
+                if (word == 0) {
+                    return upcxx::make_future(kmer_run{});
+                }
+                if (SharedSlots::slot_has_key(word, key)) {
+                    return read_slot(key_kmer, key, word, owner, slot + i, probe + i);
+                }
+            }
+            if (probe + n >= n_slots) {
+                return upcxx::make_future(kmer_run{});
+            }
+            return probe_slots(key_kmer, key, owner, (slot + n) % n_slots, probe + n);
+        });
+}
+
+// Each layout below needs only some of the parameters
+template <typename Map>
+upcxx::future<kmer_run>
+AtomicTransport<Map>::read_slot([[maybe_unused]] const pkmer_t& key_kmer,
+                                [[maybe_unused]] uint64_t key, [[maybe_unused]] uint64_t word,
+                                [[maybe_unused]] int owner, [[maybe_unused]] size_t slot,
+                                [[maybe_unused]] size_t probe) {
+#if ENTRY_IN_KEY_WORD
+    kmer_run run = {};
+    run.last = kmer_entry{word};
+    return upcxx::make_future(run);
+#else
+    const SharedSlots::Pointers& arrays = partitions[owner];
+    upcxx::future<pkmer_t> stored = SharedSlots::key_word_exact()
+                                        ? upcxx::make_future(key_kmer)
+                                        : upcxx::rget(arrays.kmers + slot);
+
+    return upcxx::rget(arrays.exts + slot).then([this, key_kmer, key, owner, slot, probe,
+                                                 stored](uint16_t ext) {
+        return stored.then([this, key_kmer, key, owner, slot, probe, ext](const pkmer_t& kmer) {
+            if (kmer != key_kmer) {
+                if (probe + 1 >= n_slots) {
+                    return upcxx::make_future(kmer_run{});
+                }
+                return probe_slots(key_kmer, key, owner, (slot + 1) % n_slots, probe + 1);
+            }
+            kmer_pair found;
+            found.kmer = kmer;
+            memcpy(found.fb_ext, &ext, 2);
+            kmer_run run = {};
+            run.last = kmer_entry::pack(found);
+            return upcxx::make_future(run);
+        });
+    });
+#endif
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hash_policy.hpp"
+#include "kmer_t.hpp"
+#include "local_table.hpp"
+#include "read_kmers.hpp"
+
+// Compares the k-mer hash policies on a real dataset: hashing throughput,
+// how evenly owner ranks are loaded, and probe lengths in each partition,
+// sized as the drivers size them. Probes are counted two ways: in groups,
+// inserting into one LocalTable per rank as the HashMap does, and in slots
+// of a linear-probe table without the LocalTable's rounding up to a power
+// of two groups, for comparison.
+//
+// usage: ./bench_hash kmer_file [ranks [load_factor]]
+
+struct HashReport {
+    double mhashes_per_s;
+    double owner_skew;
+    double mean_probe;
+    size_t max_probe;
+    std::vector<size_t> probe_histogram;
+
+    // LocalTable: most entries per slot of any partition, and groups probed
+    double max_load;
+    double mean_groups;
+    size_t max_groups;
+    size_t stashed;
+    std::vector<size_t> group_histogram;
+};
+
+// Groups LocalTable::insert scans before it finds an empty slot; 0 if the
+// k-mer goes to the stash
+size_t groups_probed(const LocalTable& table, uint64_t hash) {
+    size_t group = table.first_group(hash);
+    for (size_t probe = 0; probe < MAX_PROBE_GROUPS && probe < table.groups(); probe++) {
+        if (table.match(group, LocalTable::EMPTY) != 0) {
+            return probe + 1;
+        }
+        group = (group + probe + 1) & (table.groups() - 1);
+    }
+    return 0;
+}
+
+template <typename Hash>
+HashReport evaluate(const Hash& hasher, const std::vector<kmer_pair>& kmers, int ranks,
+                    double load_factor) {
+    HashReport report;
+    size_t n = kmers.size();
+    std::vector<uint64_t> hashes(n);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int rep = 0; rep < 10; rep++) {
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = kmers[i].kmer.hash(hasher);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    report.mhashes_per_s =
+        10.0 * n / std::chrono::duration<double, std::micro>(end - start).count();
+
+    // Same sizing and slot arithmetic as the drivers
+    size_t table_size = n / load_factor;
+    size_t local_size = table_size / ranks + 1;
+
+    std::vector<size_t> owned(ranks, 0);
+    std::vector<char> used(local_size * ranks, 0);
+    report.probe_histogram.assign(8, 0);
+    report.max_probe = 0;
+    double total_probe = 0;
+
+    std::vector<std::unique_ptr<LocalTable>> tables;
+    for (int rank = 0; rank < ranks; rank++) {
+        tables.emplace_back(new LocalTable(local_size));
+    }
+    report.group_histogram.assign(5, 0);
+    report.max_groups = 0;
+    report.stashed = 0;
+    double total_groups = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t global_slot = hashes[i] % table_size;
+        size_t owner = global_slot / local_size;
+        uint64_t local_slot = global_slot % local_size;
+        owned[owner]++;
+
+        char* partition = &used[owner * local_size];
+        size_t probe = 0;
+        while (partition[(local_slot + probe) % local_size] != 0 && probe < local_size) {
+            probe++;
+        }
+        partition[(local_slot + probe) % local_size] = 1;
+        probe++;
+
+        total_probe += probe;
+        report.max_probe = std::max(report.max_probe, probe);
+
+        // Buckets 1, 2, 3-4, 5-8, ..., >64
+        size_t bucket = 0;
+        while (bucket < 7 && probe > (size_t(1) << bucket)) {
+            bucket++;
+        }
+        report.probe_histogram[bucket]++;
+
+        // Buckets 1, 2, 3-4, 5-8, 9-16 groups
+        size_t groups = groups_probed(*tables[owner], hashes[i]);
+        if (groups == 0) {
+            report.stashed++;
+        } else {
+            total_groups += groups;
+            report.max_groups = std::max(report.max_groups, groups);
+            report.group_histogram[log2_bucket(groups, report.group_histogram.size())]++;
+        }
+        tables[owner]->insert(kmers[i], hashes[i]);
+    }
+
+    double mean_owned = double(n) / ranks;
+    report.owner_skew = *std::max_element(owned.begin(), owned.end()) / mean_owned;
+    report.mean_probe = total_probe / n;
+    report.max_load = *std::max_element(owned.begin(), owned.end()) /
+                      double(tables[0]->capacity());
+    report.mean_groups = total_groups / std::max(n - report.stashed, size_t(1));
+    return report;
+}
+
+void print_report(const char* name, const HashReport& report) {
+    printf("%-14s %8.1lf Mhash/s  owner max/mean %.3lf\n", name, report.mhashes_per_s,
+           report.owner_skew);
+    printf("%-14s groups mean %.2lf max %zu, %zu stashed, fullest table %.2lf\n", "",
+           report.mean_groups, report.max_groups, report.stashed, report.max_load);
+    printf("%-14s group histogram [1, 2, 3-4, 5-8, 9-16]:", "");
+    for (size_t count : report.group_histogram) {
+        printf(" %zu", count);
+    }
+    printf("\n");
+    printf("%-14s linear probes mean %.2lf max %zu\n", "", report.mean_probe, report.max_probe);
+    printf("%-14s linear histogram [1, 2, 3-4, 5-8, 9-16, 17-32, 33-64, >64]:", "");
+    for (size_t count : report.probe_histogram) {
+        printf(" %zu", count);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s kmer_file [ranks [load_factor]]\n", argv[0]);
+        return 1;
+    }
+
+    std::string kmer_fname = std::string(argv[1]);
+    int ranks = (argc >= 3) ? std::atoi(argv[2]) : 60;
+    double load_factor = (argc >= 4) ? std::atof(argv[3]) : MAX_LOAD_FACTOR;
+
+    int ks = kmer_size(kmer_fname);
+    if (ks != KMER_LEN) {
+        throw std::runtime_error("Error: " + kmer_fname + " contains " + std::to_string(ks) +
+                                 "-mers, while this binary is compiled for " +
+                                 std::to_string(KMER_LEN) + "-mers.");
+    }
+
+    std::vector<kmer_pair> kmers = read_kmers(kmer_fname);
+    printf("%zu %d-mers, %d ranks, load factor %.2lf\n", kmers.size(), KMER_LEN, ranks,
+           load_factor);
+
+    print_report("djb2", evaluate(Djb2Hash(), kmers, ranks, load_factor));
+    print_report("mix64 seed=0", evaluate(Mix64Hash(0), kmers, ranks, load_factor));
+    print_report("mix64 seed=1", evaluate(Mix64Hash(1), kmers, ranks, load_factor));
+    return 0;
+}
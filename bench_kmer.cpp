@@ -0,0 +1,234 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <upcxx/upcxx.hpp>
+#include <utility>
+#include <vector>
+
+#include "butil.hpp"
+#include "hash_map.hpp"
+#include "kmer_entry.hpp"
+#include "kmer_t.hpp"
+#include "local_table.hpp"
+#include "read_kmers.hpp"
+
+// Microbenchmarks for the per-k-mer operations the assemblers are built
+// from: packing, hashing, next_kmer, the local table, and the insert and
+// lookups of the distributed table with each transport (the serial one on
+// one rank only). Every rank works on its own k-mers, random ones or its
+// share of a k-mer file; the slowest rank's time per operation and the
+// total rate over all ranks are reported. On one node, build UPC++ with
+// the smp conduit to get reproducible numbers. The atomic transport keeps
+// a table per rep in the shared segment, so large runs may need a bigger
+// UPCXX_SHARED_HEAP_SIZE.
+//
+// usage: upcxx-run -n ranks ./bench_kmer [kmer_file | kmers_per_rank] [reps]
+
+// Lookups timed one at a time, since each waits for a round trip
+#define BENCH_BLOCKING_FINDS 100000
+
+// Lookups kept outstanding by the pipelined find
+#define BENCH_FINDS_IN_FLIGHT 256
+
+// Keeps results alive so the timed loops are not optimized away
+volatile uint64_t bench_sink;
+
+// Run fn reps times on every rank at once and report the slowest rank
+template <typename F> void bench(const char* name, size_t n_ops, int reps, F fn) {
+    upcxx::barrier();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int rep = 0; rep < reps; rep++) {
+        fn(rep);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    double slowest = upcxx::reduce_one(seconds, upcxx::op_fast_max, 0).wait();
+    uint64_t total_ops = upcxx::reduce_one(uint64_t(n_ops) * reps, upcxx::op_fast_add, 0).wait();
+    if (upcxx::rank_me() == 0) {
+        double per_rank = double(total_ops) / upcxx::rank_n();
+        printf("%-24s %10.2lf ns/op  %10.2lf Mops/s total\n", name, 1e9 * slowest / per_rank,
+               total_ops / slowest / 1e6);
+    }
+}
+
+std::vector<kmer_pair> random_kmers(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<kmer_pair> kmers(n);
+    std::string kmer(KMER_LEN, 'A');
+    std::string ext(2, 'F');
+    for (auto& pair : kmers) {
+        for (char& base : kmer) {
+            base = "ACGT"[rng() & 3];
+        }
+        ext[0] = "ACGTF"[rng() % 5];
+        ext[1] = "ACGTF"[rng() % 5];
+        pair.init(kmer, ext);
+    }
+    return kmers;
+}
+
+// Insert and look up k-mers in a Map with the drivers' sizing, one fresh
+// table per rep for the inserts
+template <typename Map>
+void bench_transport(const std::string& name, const std::vector<kmer_pair>& kmers, int reps,
+                     size_t hash_table_size, size_t proc_hash_table_size) {
+    size_t n = kmers.size();
+    std::vector<std::unique_ptr<Map>> hashmaps;
+    for (int rep = 0; rep < reps; rep++) {
+        hashmaps.emplace_back(new Map(hash_table_size, proc_hash_table_size));
+    }
+    upcxx::barrier();
+
+    // Includes waiting for every rank's batches to land
+    bench((name + " insert").c_str(), n, reps, [&](int rep) {
+        for (size_t i = 0; i < n; i++) {
+            if (!hashmaps[rep]->insert(kmers[i])) {
+                throw std::runtime_error("Error: HashMap is full!");
+            }
+        }
+        if (!hashmaps[rep]->send_all_buffers()) {
+            throw std::runtime_error("Error: HashMap is full!");
+        }
+        upcxx::barrier();
+    });
+
+    Map& hashmap = *hashmaps[0];
+    size_t n_blocking = std::min<size_t>(n, BENCH_BLOCKING_FINDS);
+    bench((name + " find (blocking)").c_str(), n_blocking, reps, [&](int) {
+        kmer_pair found;
+        for (size_t i = 0; i < n_blocking; i++) {
+            if (!hashmap.find(kmers[i].kmer, found)) {
+                throw std::runtime_error("Error: k-mer not found in hashmap.");
+            }
+        }
+    });
+    bench((name + " find (pipelined)").c_str(), n, reps, [&](int) {
+        int in_flight = 0;
+        bool failed = false;
+        for (size_t i = 0; i < n; i++) {
+            in_flight++;
+            hashmap.find_async(kmers[i].kmer).then([&](std::pair<bool, kmer_pair> result) {
+                failed |= !result.first;
+                in_flight--;
+            });
+            while (in_flight >= BENCH_FINDS_IN_FLIGHT) {
+                upcxx::progress();
+            }
+        }
+        while (in_flight > 0) {
+            upcxx::progress();
+        }
+        if (failed) {
+            throw std::runtime_error("Error: k-mer not found in hashmap.");
+        }
+    });
+
+    // Nobody may still be reaching into a partition when it goes
+    upcxx::barrier();
+}
+
+int main(int argc, char** argv) {
+    upcxx::init();
+
+    std::string source = (argc >= 2) ? argv[1] : "1000000";
+    int reps = (argc >= 3) ? std::atoi(argv[2]) : 5;
+
+    std::vector<kmer_pair> kmers;
+    if (!source.empty() && source.find_first_not_of("0123456789") == std::string::npos) {
+        kmers = random_kmers(std::stoull(source), 42 + upcxx::rank_me());
+    } else {
+        int ks = kmer_size(source);
+        if (ks != KMER_LEN) {
+            throw std::runtime_error("Error: " + source + " contains " + std::to_string(ks) +
+                                     "-mers, while this binary is compiled for " +
+                                     std::to_string(KMER_LEN) + "-mers.");
+        }
+        kmers = read_kmers(source, upcxx::rank_n(), upcxx::rank_me());
+    }
+    size_t n = kmers.size();
+    size_t n_total = upcxx::reduce_all(n, upcxx::op_fast_add).wait();
+
+    BUtil::print("K=%d, %d ranks, %zu k-mers per rank, %d reps\n", KMER_LEN, upcxx::rank_n(), n,
+                 reps);
+
+    // Packing and the operations on packed k-mers
+    std::vector<char> text(n * KMER_LEN);
+    for (size_t i = 0; i < n; i++) {
+        unpackKmer(kmers[i].kmer.data, &text[i * KMER_LEN]);
+    }
+    std::vector<pkmer_t> packed(n);
+
+    bench("packKmer", n, reps, [&](int) {
+        for (size_t i = 0; i < n; i++) {
+            packKmer(&text[i * KMER_LEN], packed[i].data);
+        }
+    });
+    bench("unpackKmer", n, reps, [&](int) {
+        for (size_t i = 0; i < n; i++) {
+            unpackKmer(packed[i].data, &text[i * KMER_LEN]);
+        }
+    });
+    bench("pkmer_t::hash", n, reps, [&](int) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum += packed[i].hash();
+        }
+        bench_sink = sum;
+    });
+    bench("kmer_pair::next_kmer", n, reps, [&](int) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum += kmers[i].next_kmer().data[0];
+        }
+        bench_sink = sum;
+    });
+
+    // The local table, one fresh table per rep, sized like the drivers size a partition
+    size_t local_capacity = n / MAX_LOAD_FACTOR + 1;
+    std::vector<std::unique_ptr<GrowableTable>> tables;
+    for (int rep = 0; rep < reps; rep++) {
+        tables.emplace_back(new GrowableTable(local_capacity));
+    }
+    std::vector<uint64_t> hashes(n);
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = kmers[i].hash();
+    }
+
+    bench("local insert", n, reps, [&](int rep) {
+        for (size_t i = 0; i < n; i++) {
+            if (!tables[rep]->insert(kmers[i], hashes[i])) {
+                throw std::runtime_error("Error: local table is full!");
+            }
+        }
+    });
+    bench("local find", n, reps, [&](int) {
+        kmer_pair found;
+        for (size_t i = 0; i < n; i++) {
+            if (!tables[0]->find(kmers[i].kmer, hashes[i], found)) {
+                throw std::runtime_error("Error: k-mer not found in local table.");
+            }
+        }
+    });
+    tables.clear();
+
+    // The distributed table, once per transport
+    size_t hash_table_size = n_total / MAX_LOAD_FACTOR;
+    size_t proc_hash_table_size = hash_table_size / upcxx::rank_n() + 1;
+    if (upcxx::rank_n() == 1) {
+        bench_transport<SerialHashMap>("serial", kmers, reps, hash_table_size,
+                                       proc_hash_table_size);
+    }
+    bench_transport<RpcHashMap>("rpc", kmers, reps, hash_table_size, proc_hash_table_size);
+    bench_transport<AtomicHashMap>("atomic", kmers, reps, hash_table_size, proc_hash_table_size);
+    bench_transport<MailboxHashMap>("mailbox", kmers, reps, hash_table_size, proc_hash_table_size);
+
+    upcxx::finalize();
+    return 0;
+}
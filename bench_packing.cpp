@@ -0,0 +1,79 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "packing.hpp"
+
+// Microbenchmark for the 2-bit packing kernels: scalar table lookups
+// against the vector kernels, single k-mer and bulk, at this KMER_LEN.
+
+template <typename F> double time_ns_per_kmer(size_t n_kmers, int reps, F fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int rep = 0; rep < reps; rep++) {
+        fn();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (n_kmers * reps);
+}
+
+int main(int argc, char** argv) {
+    size_t n_kmers = (argc >= 2) ? std::stoul(argv[1]) : (1 << 20);
+    int reps = (argc >= 3) ? std::stoi(argv[2]) : 10;
+
+    // Text lines as they appear in the input files: k-mer, space, extensions, newline
+    const size_t line_len = KMER_LEN + 4;
+    std::vector<char> text(n_kmers * line_len);
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i < n_kmers; i++) {
+        char* line = &text[i * line_len];
+        for (int j = 0; j < KMER_LEN; j++) {
+            line[j] = "ACGT"[rng() & 3];
+        }
+        memcpy(line + KMER_LEN, " FF\n", 4);
+    }
+
+    std::vector<unsigned char> packed_scalar(n_kmers * PACKED_KMER_LEN);
+    std::vector<unsigned char> packed_vector(n_kmers * PACKED_KMER_LEN);
+    std::vector<char> unpacked_scalar(n_kmers * KMER_LEN);
+    std::vector<char> unpacked_vector(n_kmers * KMER_LEN);
+
+    double pack_scalar = time_ns_per_kmer(n_kmers, reps, [&]() {
+        for (size_t i = 0; i < n_kmers; i++) {
+            packKmerScalar(&text[i * line_len], &packed_scalar[i * PACKED_KMER_LEN]);
+        }
+    });
+    double pack_vector = time_ns_per_kmer(n_kmers, reps, [&]() {
+        packKmers(text.data(), line_len, n_kmers, packed_vector.data(), PACKED_KMER_LEN);
+    });
+    double unpack_scalar = time_ns_per_kmer(n_kmers, reps, [&]() {
+        for (size_t i = 0; i < n_kmers; i++) {
+            unpackKmerScalar(&packed_scalar[i * PACKED_KMER_LEN], &unpacked_scalar[i * KMER_LEN]);
+        }
+    });
+    double unpack_vector = time_ns_per_kmer(n_kmers, reps, [&]() {
+        unpackKmers(packed_vector.data(), PACKED_KMER_LEN, n_kmers, unpacked_vector.data(),
+                    KMER_LEN);
+    });
+
+    if (packed_scalar != packed_vector || unpacked_scalar != unpacked_vector) {
+        throw std::runtime_error("Error: scalar and vector kernels disagree.");
+    }
+    for (size_t i = 0; i < n_kmers; i++) {
+        if (memcmp(&unpacked_vector[i * KMER_LEN], &text[i * line_len], KMER_LEN) != 0) {
+            throw std::runtime_error("Error: pack/unpack round trip failed.");
+        }
+    }
+
+    printf("K=%d, %zu k-mers x %d reps, vector kernels: %s\n", KMER_LEN, n_kmers, reps,
+           packing_kernel_names[packing_kernels]);
+    printf("pack:   scalar %7.2lf ns/kmer, vector %7.2lf ns/kmer (%.2lfx)\n", pack_scalar,
+           pack_vector, pack_scalar / pack_vector);
+    printf("unpack: scalar %7.2lf ns/kmer, vector %7.2lf ns/kmer (%.2lfx)\n", unpack_scalar,
+           unpack_vector, unpack_scalar / unpack_vector);
+    return 0;
+}
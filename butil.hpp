@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdlib>
+#include <string>
 #include <upcxx/upcxx.hpp>
 
 namespace BUtil {
@@ -12,4 +14,22 @@ template <typename... Args> void print(std::string format, Args... args) {
     fflush(stdout);
     upcxx::barrier();
 }
+
+// Read an integer knob from the environment, falling back to default_value.
+inline int env_int(const char* name, int default_value) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || *value == '\0') {
+        return default_value;
+    }
+    return std::atoi(value);
+}
+
+// Read a string knob from the environment, falling back to default_value.
+inline std::string env_string(const char* name, const std::string& default_value) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || *value == '\0') {
+        return default_value;
+    }
+    return value;
+}
 } // namespace BUtil
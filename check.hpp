@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdio>
+#include <exception>
+
+// Checks for the test_* executables. A failed check prints where it is and
+// the test keeps going; check_result() is what main returns, so ctest sees
+// the failure.
+
+int check_failures = 0;
+
+#define CHECK(cond)                                                                    \
+    do {                                                                               \
+        if (!(cond)) {                                                                 \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);   \
+            check_failures++;                                                          \
+        }                                                                              \
+    } while (0)
+
+// expr must throw a std::exception
+#define CHECK_THROWS(expr)                                                             \
+    do {                                                                               \
+        bool thrown = false;                                                           \
+        try {                                                                          \
+            expr;                                                                      \
+        } catch (const std::exception&) {                                              \
+            thrown = true;                                                             \
+        }                                                                              \
+        if (!thrown) {                                                                 \
+            fprintf(stderr, "%s:%d: %s did not throw\n", __FILE__, __LINE__, #expr);   \
+            check_failures++;                                                          \
+        }                                                                              \
+    } while (0)
+
+int check_result() {
+    if (check_failures != 0) {
+        fprintf(stderr, "%d checks failed\n", check_failures);
+        return 1;
+    }
+    return 0;
+}
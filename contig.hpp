@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "kmer_t.hpp"
+#include "packing.hpp"
+
+// Append a base, as its 2-bit code or as ASCII, to a run of n_bases bases
+// packed four to a byte
+template <typename Bytes> void pack_code(Bytes& packed, size_t n_bases, unsigned char code) {
+    int pos = n_bases % 4;
+    if (pos == 0) {
+        packed.push_back(0);
+    }
+    packed.back() |= code << (6 - 2 * pos);
+}
+
+template <typename Bytes> void pack_base(Bytes& packed, size_t n_bases, char base) {
+    pack_code(packed, n_bases, baseToCode.code[(unsigned char)base]);
+}
+
+// A contig as its first k-mer plus the bases each later k-mer adds, packed
+// four to a byte like pkmer_t and allocated from the arena of its
+// ContigSet. Walks only need the last k-mer, so no other k-mer is kept and
+// ASCII is produced only by str().
+struct Contig {
+    kmer_pair first;
+    kmer_pair last;
+
+    // Bases after the first k-mer
+    size_t n_bases;
+    std::pmr::vector<unsigned char> packed;
+
+    Contig(const kmer_pair& start, std::pmr::memory_resource* arena);
+
+    // The k-mer the walk continues from, and appending the next one
+    const kmer_pair& back() const noexcept;
+    void push_back(const kmer_pair& kmer);
+
+    // Append a run of k-mers, given as the n bases all but the last of
+    // them add, packed four to a byte, and the last one
+    void append(const unsigned char* bases, size_t n, const kmer_pair& kmer);
+
+    // Number of k-mers, and of bases
+    size_t size() const noexcept;
+    size_t length() const noexcept;
+
+    std::string str() const;
+};
+
+Contig::Contig(const kmer_pair& start, std::pmr::memory_resource* arena)
+    : first(start), last(start), n_bases(0), packed(arena) {}
+
+const kmer_pair& Contig::back() const noexcept { return last; }
+
+void Contig::push_back(const kmer_pair& kmer) {
+    // The k-mer adds the base its predecessor names as forward extension
+    pack_base(packed, n_bases, last.forwardExt());
+    n_bases++;
+    last = kmer;
+}
+
+void Contig::append(const unsigned char* bases, size_t n, const kmer_pair& kmer) {
+    pack_base(packed, n_bases, last.forwardExt());
+    n_bases++;
+    for (size_t i = 0; i < n; i++) {
+        pack_code(packed, n_bases, (bases[i / 4] >> (6 - 2 * (i % 4))) & 3);
+        n_bases++;
+    }
+    last = kmer;
+}
+
+size_t Contig::size() const noexcept { return n_bases + 1; }
+
+size_t Contig::length() const noexcept { return KMER_LEN + n_bases; }
+
+std::string Contig::str() const {
+    std::string contig(length(), 'A');
+    unpackKmer(first.kmer.data, &contig[0]);
+
+    char* bases = &contig[KMER_LEN];
+    size_t i = 0;
+    for (; i + 4 <= n_bases; i += 4) {
+        memcpy(bases + i, &packedCodeToFourMer.chars[packed[i / 4]], 4);
+    }
+    if (i < n_bases) {
+        char block[4];
+        memcpy(block, &packedCodeToFourMer.chars[packed[i / 4]], 4);
+        memcpy(bases + i, block, n_bases - i);
+    }
+    return contig;
+}
+
+std::string extract_contig(const Contig& contig) { return contig.str(); }
+
+// The contigs of one traversal and the arenas their bases live in. Contigs
+// never move once added, so walks in flight can hold references to them.
+struct ContigSet {
+    std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> arenas;
+    std::deque<Contig> contigs;
+
+    ContigSet();
+
+    Contig& add(const kmer_pair& start);
+
+    // Take over other's contigs and arenas, leaving it empty
+    void splice(ContigSet& other);
+
+    size_t size() const noexcept;
+    std::deque<Contig>::const_iterator begin() const noexcept;
+    std::deque<Contig>::const_iterator end() const noexcept;
+};
+
+ContigSet::ContigSet() { arenas.emplace_back(new std::pmr::monotonic_buffer_resource()); }
+
+Contig& ContigSet::add(const kmer_pair& start) {
+    contigs.emplace_back(start, arenas.front().get());
+    return contigs.back();
+}
+
+void ContigSet::splice(ContigSet& other) {
+    for (auto& arena : other.arenas) {
+        arenas.push_back(std::move(arena));
+    }
+    for (auto& contig : other.contigs) {
+        contigs.push_back(std::move(contig));
+    }
+    other.arenas.clear();
+    other.contigs.clear();
+    other.arenas.emplace_back(new std::pmr::monotonic_buffer_resource());
+}
+
+size_t ContigSet::size() const noexcept { return contigs.size(); }
+
+std::deque<Contig>::const_iterator ContigSet::begin() const noexcept { return contigs.begin(); }
+
+std::deque<Contig>::const_iterator ContigSet::end() const noexcept { return contigs.end(); }
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <upcxx/upcxx.hpp>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "contig.hpp"
+#include "trace.hpp"
+
+// Output bytes gathered on a rank before they are given a place in the file
+#define OUTPUT_CHUNK (1 << 20)
+
+// Writes the contigs of every rank into one shared file. Contigs are
+// appended to a local chunk as their walks finish. A full chunk claims the
+// next free bytes of the file with a fetch_add on a counter held by rank 0;
+// once the claim completes, the chunk goes to a background thread that
+// pwrite()s it, so neither claiming nor writing holds up the traversal.
+// close() places what is left on each rank after all of the chunks, with
+// one more fetch_add per rank.
+//
+// With flush_lines every contig goes out as soon as it is added, like the
+// std::endl output this replaces; otherwise nothing is flushed per line.
+//
+// add() makes no UPC++ calls, so it may be called from several threads.
+// pump() only starts claims, so it may be called from completions too.
+// A claim completes on the persona that started it, so each thread that
+// pumps must wait_claims() before it stops making progress. close() must
+// not be called from completions.
+struct ContigWriter {
+    int fd;
+    bool flush_lines;
+
+    // Bytes of the file claimed so far, on rank 0
+    upcxx::global_ptr<uint64_t> tail;
+    upcxx::atomic_domain<uint64_t> ad;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::string current;
+    // Chunks waiting for a place in the file, and placed chunks waiting for
+    // the writer thread
+    std::vector<std::string> unclaimed;
+    std::deque<std::pair<uint64_t, std::string>> placed;
+    bool closing;
+    std::exception_ptr error;
+    bool closed;
+
+    std::thread writer;
+
+    // Collective. Creates (or truncates) fname.
+    ContigWriter(const std::string& fname, bool flush_lines);
+    ~ContigWriter();
+
+    void add(const Contig& contig);
+    void add(const std::string& contig);
+
+    // Start claiming places for the full chunks; each goes to the writer
+    // once its claim completes
+    void pump();
+
+    // Make progress until the claims this thread started have completed
+    void wait_claims();
+
+    // Collective. Writes the remainders and waits for every write to land.
+    void close();
+
+    void write_all();
+    void shut_down();
+
+    // Claims this thread has started that have not completed
+    static int& claims_in_flight();
+};
+
+ContigWriter::ContigWriter(const std::string& fname, bool flush_lines)
+    : fd(-1), flush_lines(flush_lines),
+      ad({upcxx::atomic_op::fetch_add}), closing(false), closed(false) {
+    if (upcxx::rank_me() == 0) {
+        tail = upcxx::new_<uint64_t>(0);
+        fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    tail = upcxx::broadcast(tail, 0).wait();
+    upcxx::barrier();
+    if (upcxx::rank_me() != 0) {
+        fd = open(fname.c_str(), O_WRONLY);
+    }
+    if (fd < 0) {
+        throw std::runtime_error("Error: could not open " + fname);
+    }
+
+    writer = std::thread([this]() { write_all(); });
+}
+
+ContigWriter::~ContigWriter() {
+    shut_down();
+    // Without close(), as when an exception unwinds past the writer, the
+    // other ranks may not get here; free the domain without a barrier
+    if (!closed) {
+        ad.destroy(upcxx::entry_barrier::none);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+void ContigWriter::add(const Contig& contig) { add(contig.str()); }
+
+void ContigWriter::add(const std::string& contig) {
+    std::lock_guard<std::mutex> guard(lock);
+    current += contig;
+    current += '\n';
+    if (flush_lines || current.size() >= OUTPUT_CHUNK) {
+        unclaimed.push_back(std::move(current));
+        current.clear();
+    }
+}
+
+void ContigWriter::pump() {
+    std::vector<std::string> chunks;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (unclaimed.empty()) {
+            return;
+        }
+        chunks.swap(unclaimed);
+    }
+
+    for (auto& chunk : chunks) {
+        TRACE_INSTANT("claim chunk", chunk.size());
+        claims_in_flight()++;
+        uint64_t size = chunk.size();
+        ad.fetch_add(tail, size, std::memory_order_relaxed)
+            .then([this, chunk = std::move(chunk)](uint64_t offset) mutable {
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    placed.emplace_back(offset, std::move(chunk));
+                    changed.notify_all();
+                }
+                claims_in_flight()--;
+            });
+    }
+}
+
+void ContigWriter::wait_claims() {
+    if (claims_in_flight() > 0) {
+        TRACE_SPAN("wait for claims");
+        while (claims_in_flight() > 0) {
+            upcxx::progress();
+        }
+    }
+}
+
+int& ContigWriter::claims_in_flight() {
+    static thread_local int n_claims = 0;
+    return n_claims;
+}
+
+void ContigWriter::close() {
+    pump();
+    wait_claims();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!unclaimed.empty()) {
+            throw std::runtime_error("Error: contigs added while the output was closing.");
+        }
+    }
+    upcxx::barrier();
+
+    // Every chunk is placed; the remainders go after them
+    uint64_t offset = ad.fetch_add(tail, current.size(), std::memory_order_relaxed).wait();
+    if (!current.empty()) {
+        std::lock_guard<std::mutex> guard(lock);
+        placed.emplace_back(offset, std::move(current));
+        current.clear();
+        changed.notify_all();
+    }
+
+    shut_down();
+    upcxx::barrier();
+
+    ad.destroy();
+    closed = true;
+    if (upcxx::rank_me() == 0) {
+        upcxx::delete_(tail);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ContigWriter::write_all() {
+    while (true) {
+        std::pair<uint64_t, std::string> chunk;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [this]() { return !placed.empty() || closing; });
+            if (placed.empty()) {
+                return;
+            }
+            chunk = std::move(placed.front());
+            placed.pop_front();
+        }
+
+        TRACE_SPAN_ARG("pwrite", chunk.second.size());
+        const char* data = chunk.second.data();
+        size_t left = chunk.second.size();
+        off_t offset = chunk.first;
+        while (left > 0) {
+            ssize_t n = pwrite(fd, data, left, offset);
+            if (n < 0) {
+                std::lock_guard<std::mutex> guard(lock);
+                error = std::make_exception_ptr(std::runtime_error("Error: could not write contigs."));
+                break;
+            }
+            data += n;
+            left -= n;
+            offset += n;
+        }
+    }
+}
+
+// Let the writer drain what is placed, then stop it
+void ContigWriter::shut_down() {
+    if (!writer.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closing = true;
+        changed.notify_all();
+    }
+    writer.join();
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <upcxx/upcxx.hpp>
+#include <utility>
+#include <vector>
+
+// Per-rank event counters for the hash table and the traversal, reduced
+// across ranks at the end of a run by report_counters(). Each thread counts
+// into its own Counters, so counting is a plain add; compile with
+// -DKMER_COUNTERS=0 to remove the counting altogether.
+#ifndef KMER_COUNTERS
+#define KMER_COUNTERS 1
+#endif
+
+#if KMER_COUNTERS
+#define COUNT(statements) \
+    do {                  \
+        statements;       \
+    } while (0)
+#else
+#define COUNT(statements) \
+    do {                  \
+    } while (0)
+#endif
+
+// Probe length buckets, in groups: 1, 2, 3-4, 5-8, ..., >64 or stashed
+#define PROBE_BUCKETS 8
+
+// Remote find latency buckets, in microseconds: <=1, 2, 3-4, ..., >16384
+#define LATENCY_BUCKETS 16
+
+struct Counters {
+    uint64_t inserts = 0;
+    uint64_t local_finds = 0;
+    uint64_t remote_finds = 0;
+    uint64_t buffer_flushes = 0;
+
+    // Contigs walked, k-mers appended to them, and how often a walk had
+    // to wait for a remote lookup
+    uint64_t walks = 0;
+    uint64_t walk_steps = 0;
+    uint64_t walk_waits = 0;
+    // Steps that needed no message: the k-mer was on the rank the walk was
+    // on, or came in the same run as the one before it
+    uint64_t local_steps = 0;
+    // Walks forwarded to the next owner, when walks migrate
+    uint64_t walk_hops = 0;
+
+    // Successful steals of start nodes, and the start nodes they brought
+    uint64_t steals = 0;
+    uint64_t stolen = 0;
+
+    uint64_t probes[PROBE_BUCKETS] = {};
+    uint64_t find_latency[LATENCY_BUCKETS] = {};
+
+    // RPCs and payload bytes sent to each rank
+    std::vector<uint64_t> rpcs_to;
+    std::vector<uint64_t> bytes_to;
+
+    void add(const Counters& other);
+    void count_rpc(int target_rank, size_t bytes);
+};
+
+// Bucket b holds values in (2^(b-1), 2^b]; the last one everything larger
+size_t log2_bucket(uint64_t value, size_t n_buckets) {
+    size_t bucket = 0;
+    while (bucket + 1 < n_buckets && value > (uint64_t(1) << bucket)) {
+        bucket++;
+    }
+    return bucket;
+}
+
+void Counters::add(const Counters& other) {
+    inserts += other.inserts;
+    local_finds += other.local_finds;
+    remote_finds += other.remote_finds;
+    buffer_flushes += other.buffer_flushes;
+    walks += other.walks;
+    walk_steps += other.walk_steps;
+    walk_waits += other.walk_waits;
+    local_steps += other.local_steps;
+    walk_hops += other.walk_hops;
+    steals += other.steals;
+    stolen += other.stolen;
+    for (size_t i = 0; i < PROBE_BUCKETS; i++) {
+        probes[i] += other.probes[i];
+    }
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        find_latency[i] += other.find_latency[i];
+    }
+    rpcs_to.resize(std::max(rpcs_to.size(), other.rpcs_to.size()), 0);
+    bytes_to.resize(std::max(bytes_to.size(), other.bytes_to.size()), 0);
+    for (size_t i = 0; i < other.rpcs_to.size(); i++) {
+        rpcs_to[i] += other.rpcs_to[i];
+        bytes_to[i] += other.bytes_to[i];
+    }
+}
+
+void Counters::count_rpc(int target_rank, size_t bytes) {
+    if (rpcs_to.empty()) {
+        rpcs_to.assign(upcxx::rank_n(), 0);
+        bytes_to.assign(upcxx::rank_n(), 0);
+    }
+    rpcs_to[target_rank]++;
+    bytes_to[target_rank] += bytes;
+}
+
+// Every thread's counters, kept past the thread's exit so they can be summed
+struct CounterRegistry {
+    std::mutex lock;
+    std::vector<std::unique_ptr<Counters>> threads;
+};
+
+CounterRegistry& counter_registry() {
+    static CounterRegistry registry;
+    return registry;
+}
+
+// The calling thread's counters
+Counters& counters() {
+    thread_local Counters* mine = nullptr;
+    if (mine == nullptr) {
+        CounterRegistry& registry = counter_registry();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        registry.threads.emplace_back(new Counters());
+        mine = registry.threads.back().get();
+    }
+    return *mine;
+}
+
+void count_find_latency(std::chrono::steady_clock::time_point sent) {
+    auto elapsed = std::chrono::steady_clock::now() - sent;
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    counters().find_latency[log2_bucket(us, LATENCY_BUCKETS)]++;
+}
+
+// This rank's counters, summed over its threads
+Counters rank_counters() {
+    Counters total;
+    total.rpcs_to.assign(upcxx::rank_n(), 0);
+    total.bytes_to.assign(upcxx::rank_n(), 0);
+    CounterRegistry& registry = counter_registry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    for (const auto& thread : registry.threads) {
+        total.add(*thread);
+    }
+    return total;
+}
+
+void print_histogram(const char* name, const char* buckets, const std::vector<uint64_t>& counts) {
+    printf("%-22s %s:", name, buckets);
+    for (uint64_t count : counts) {
+        printf(" %lu", (unsigned long)count);
+    }
+    printf("\n");
+}
+
+// Collective. Prints, on rank 0, the min, mean and max over ranks of each
+// counter and of each named value in extra (timings, say), with max/mean
+// as the imbalance. RPCs and bytes are also shown per receiving rank, to
+// spot hot owners, and the histograms are summed over ranks.
+void report_counters(const std::vector<std::pair<std::string, double>>& extra) {
+    Counters mine = rank_counters();
+
+    std::vector<std::pair<std::string, double>> values = extra;
+    uint64_t rpcs_sent = 0, bytes_sent = 0;
+    for (int rank = 0; rank < upcxx::rank_n(); rank++) {
+        rpcs_sent += mine.rpcs_to[rank];
+        bytes_sent += mine.bytes_to[rank];
+    }
+    values.emplace_back("inserts", mine.inserts);
+    values.emplace_back("local finds", mine.local_finds);
+    values.emplace_back("remote finds", mine.remote_finds);
+    values.emplace_back("buffer flushes", mine.buffer_flushes);
+    values.emplace_back("rpcs sent", rpcs_sent);
+    values.emplace_back("bytes sent", bytes_sent);
+    values.emplace_back("contigs walked", mine.walks);
+    values.emplace_back("walk steps", mine.walk_steps);
+    values.emplace_back("walk waits", mine.walk_waits);
+    values.emplace_back("local steps", mine.local_steps);
+    values.emplace_back("local step fraction",
+                        mine.walk_steps > 0 ? double(mine.local_steps) / mine.walk_steps : 0.0);
+    values.emplace_back("walk hops", mine.walk_hops);
+    values.emplace_back("steals", mine.steals);
+    values.emplace_back("start nodes stolen", mine.stolen);
+
+    size_t n = values.size();
+    std::vector<double> value(n), mins(n), maxes(n), sums(n);
+    for (size_t i = 0; i < n; i++) {
+        value[i] = values[i].second;
+    }
+    upcxx::reduce_one(value.data(), mins.data(), n, upcxx::op_fast_min, 0).wait();
+    upcxx::reduce_one(value.data(), maxes.data(), n, upcxx::op_fast_max, 0).wait();
+    upcxx::reduce_one(value.data(), sums.data(), n, upcxx::op_fast_add, 0).wait();
+
+    // What every rank received, and the histograms over all ranks
+    int n_ranks = upcxx::rank_n();
+    std::vector<uint64_t> rpcs_in(n_ranks), bytes_in(n_ranks);
+    std::vector<uint64_t> probes(PROBE_BUCKETS), latency(LATENCY_BUCKETS);
+    upcxx::reduce_one(mine.rpcs_to.data(), rpcs_in.data(), n_ranks, upcxx::op_fast_add, 0).wait();
+    upcxx::reduce_one(mine.bytes_to.data(), bytes_in.data(), n_ranks, upcxx::op_fast_add, 0).wait();
+    upcxx::reduce_one(mine.probes, probes.data(), PROBE_BUCKETS, upcxx::op_fast_add, 0).wait();
+    upcxx::reduce_one(mine.find_latency, latency.data(), LATENCY_BUCKETS, upcxx::op_fast_add, 0)
+        .wait();
+
+    if (upcxx::rank_me() != 0) {
+        return;
+    }
+
+    printf("%-22s %14s %14s %14s %9s\n", "per rank", "min", "mean", "max", "max/mean");
+    auto print_row = [](const std::string& name, double low, double mean, double high) {
+        printf("%-22s %14.6g %14.6g %14.6g %9.3lf\n", name.c_str(), low, mean, high,
+               mean > 0 ? high / mean : 1.0);
+    };
+    for (size_t i = 0; i < n; i++) {
+        print_row(values[i].first, mins[i], sums[i] / n_ranks, maxes[i]);
+    }
+
+    for (auto received : {std::make_pair("rpcs received", &rpcs_in),
+                          std::make_pair("bytes received", &bytes_in)}) {
+        const std::vector<uint64_t>& counts = *received.second;
+        uint64_t low = counts[0], high = counts[0], total = 0;
+        int hottest = 0;
+        for (int rank = 0; rank < n_ranks; rank++) {
+            low = std::min(low, counts[rank]);
+            total += counts[rank];
+            if (counts[rank] > high) {
+                high = counts[rank];
+                hottest = rank;
+            }
+        }
+        print_row(received.first, low, double(total) / n_ranks, high);
+        printf("%-22s hottest owner: rank %d\n", "", hottest);
+    }
+
+    print_histogram("insert probe groups", "[1, 2, 3-4, 5-8, 9-16, 17-32, 33-64, >64]", probes);
+    print_histogram("remote find latency", "[<=1us, 2us, ..., >16ms]", latency);
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Writes a synthetic k-mer file in the input format: the k-mers of random
+// contigs, one "KMER BF" line each, in shuffled order. No k-mer occurs
+// twice, so the assemblers rebuild exactly the generated contigs. Contig
+// lengths, in k-mers, are drawn from one of
+//
+//     fixed        every contig has mean_len k-mers
+//     uniform      uniform on [1, 2 * mean_len - 1]
+//     exponential  geometric with mean mean_len, so many short contigs
+//                  and a few long ones, like the real datasets
+//
+// usage: ./gen_kmers out_file K n_kmers [mean_len [fixed|uniform|exponential [seed]]]
+
+// Draws contig lengths in k-mers
+struct LengthDistribution {
+    std::string kind;
+    double mean_len;
+    std::uniform_int_distribution<uint64_t> uniform;
+    std::geometric_distribution<uint64_t> geometric;
+
+    LengthDistribution(const std::string& kind, double mean_len)
+        : kind(kind), mean_len(mean_len), uniform(1, 2 * (uint64_t)mean_len - 1),
+          geometric(1.0 / mean_len) {}
+
+    template <typename Rng> uint64_t operator()(Rng& rng) {
+        if (kind == "uniform") {
+            return uniform(rng);
+        } else if (kind == "exponential") {
+            return geometric(rng) + 1;
+        }
+        return (uint64_t)mean_len;
+    }
+};
+
+uint64_t kmer_key(const char* kmer, int k) {
+    return std::hash<std::string>()(std::string(kmer, k));
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s out_file K n_kmers [mean_len [fixed|uniform|exponential "
+                        "[seed]]]\n",
+                argv[0]);
+        return 1;
+    }
+    std::string out_fname = argv[1];
+    int k = std::atoi(argv[2]);
+    uint64_t n_kmers = std::strtoull(argv[3], NULL, 10);
+    double mean_len = (argc >= 5) ? std::atof(argv[4]) : 100;
+    std::string kind = (argc >= 6) ? argv[5] : "exponential";
+    uint64_t seed = (argc >= 7) ? std::strtoull(argv[6], NULL, 10) : 42;
+
+    if (k < 2 || mean_len < 1 || (kind != "fixed" && kind != "uniform" && kind != "exponential")) {
+        fprintf(stderr, "Error: need K >= 2, mean_len >= 1 and a known distribution.\n");
+        return 1;
+    }
+    if (k < 32 && n_kmers > (uint64_t(1) << (2 * k)) / 2) {
+        fprintf(stderr, "Error: too many k-mers for K=%d.\n", k);
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+    LengthDistribution contig_len(kind, mean_len);
+
+    // Fixed-width lines: k-mer, space, backward and forward extension, newline
+    const size_t line_len = k + 4;
+    std::vector<char> lines(n_kmers * line_len);
+    std::unordered_set<uint64_t> seen;
+    seen.reserve(n_kmers);
+
+    uint64_t n_written = 0, n_contigs = 0;
+    std::string contig;
+    while (n_written < n_kmers) {
+        uint64_t want = std::min(contig_len(rng), n_kmers - n_written);
+
+        // Grow the contig one base at a time, avoiding k-mers already used;
+        // it ends early when every next base would repeat one
+        do {
+            contig.clear();
+            for (int i = 0; i < k; i++) {
+                contig += "ACGT"[rng() & 3];
+            }
+        } while (seen.count(kmer_key(contig.data(), k)) != 0);
+        seen.insert(kmer_key(contig.data(), k));
+
+        while (contig.size() - k + 1 < want) {
+            int first = rng() & 3;
+            bool extended = false;
+            for (int i = 0; i < 4 && !extended; i++) {
+                contig += "ACGT"[(first + i) & 3];
+                uint64_t key = kmer_key(contig.data() + contig.size() - k, k);
+                extended = seen.insert(key).second;
+                if (!extended) {
+                    contig.pop_back();
+                }
+            }
+            if (!extended) {
+                break;
+            }
+        }
+
+        uint64_t n_contig_kmers = contig.size() - k + 1;
+        for (uint64_t i = 0; i < n_contig_kmers; i++) {
+            char* line = &lines[(n_written + i) * line_len];
+            memcpy(line, contig.data() + i, k);
+            line[k] = ' ';
+            line[k + 1] = (i == 0) ? 'F' : contig[i - 1];
+            line[k + 2] = (i + 1 == n_contig_kmers) ? 'F' : contig[i + k];
+            line[k + 3] = '\n';
+        }
+        n_written += n_contig_kmers;
+        n_contigs++;
+    }
+
+    // Real inputs are not grouped by contig
+    std::vector<char> tmp(line_len);
+    for (uint64_t i = n_kmers; i-- > 1;) {
+        uint64_t j = std::uniform_int_distribution<uint64_t>(0, i)(rng);
+        memcpy(tmp.data(), &lines[i * line_len], line_len);
+        memcpy(&lines[i * line_len], &lines[j * line_len], line_len);
+        memcpy(&lines[j * line_len], tmp.data(), line_len);
+    }
+
+    FILE* f = fopen(out_fname.c_str(), "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", out_fname.c_str());
+        return 1;
+    }
+    bool written = fwrite(lines.data(), 1, lines.size(), f) == lines.size();
+    if (fclose(f) != 0 || !written) {
+        fprintf(stderr, "Error: could not write %s\n", out_fname.c_str());
+        return 1;
+    }
+
+    printf("Wrote %zu %d-mers in %zu contigs (%s, mean %.1lf k-mers) to %s.\n", (size_t)n_kmers, k,
+           (size_t)n_contigs, kind.c_str(), n_contigs ? double(n_kmers) / n_contigs : 0.0,
+           out_fname.c_str());
+    return 0;
+}
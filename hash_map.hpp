@@ -1,83 +1,262 @@
 #pragma once
 
-#include "kmer_t.hpp"
+#include <chrono>
+#include <type_traits>
 #include <upcxx/upcxx.hpp>
+#include <utility>
+
+#include "atomic_transport.hpp"
+#include "contig.hpp"
+#include "counters.hpp"
+#include "hash_policy.hpp"
+#include "kmer_entry.hpp"
+#include "kmer_run.hpp"
+#include "kmer_t.hpp"
+#include "local_table.hpp"
+#include "mailbox_transport.hpp"
+#include "rpc_transport.hpp"
+#include "serial_transport.hpp"
+#include "shared_slots.hpp"
+#include "trace.hpp"
+
+// Most k-mers a remote find follows on their owner
+#define FIND_RUN_DEPTH 64
+
+// Length of the m-mers whose minimizer picks the owner, when k-mers are
+// partitioned by minimizer
+#ifndef MINIMIZER_LEN
+#define MINIMIZER_LEN (KMER_LEN / 2 + 1 < 32 ? KMER_LEN / 2 + 1 : 32)
+#endif
+
+// Storage that rehashes what it moves has to hash like the map
+template <typename Storage, typename Hash> struct storage_hashes_with : std::true_type {};
+template <typename TableHash, typename Hash>
+struct storage_hashes_with<BasicGrowableTable<TableHash>, Hash> : std::is_same<TableHash, Hash> {};
 
+// The distributed k-mer table. Each rank holds the partition of the k-mers
+// it owns in a Storage, and a Transport<HashMap> decides how k-mers reach
+// the partitions of other ranks and how they are found there:
+//
+//   SerialTransport   everything local, one rank only
+//   RpcTransport      RPCs carrying batches, runs followed on the owner
+//   AtomicTransport   remote CAS and rget, nothing run on the owner
+//   MailboxTransport  batches put into the owner's segment, RPC finds
+//
+// The Storage must suit the Transport: AtomicTransport probes SharedSlots
+// one-sidedly, the others insert into a GrowableTable on the owner. Hash
+// picks the owner and the slot, the same on every rank.
+template <typename Storage, template <typename> class Transport, typename Hash = DefaultKmerHash>
 struct HashMap {
-    std::vector<kmer_pair> data;
-    std::vector<int> used;
+    typedef Storage storage_type;
+    typedef Transport<HashMap> transport_type;
+    typedef typename transport_type::SendBuffers SendBuffers;
 
-    size_t my_size;
+    static_assert(storage_hashes_with<Storage, Hash>::value,
+                  "the storage must rehash with the map's Hash");
 
+    size_t full_table_size;
     size_t size() const noexcept;
 
-    HashMap(size_t size);
+    size_t local_table_size;
+    size_t local_size() const noexcept;
+
+    Hash hasher;
+
+    // When non-zero, k-mers go to the owner of their minimizer over
+    // m-mers of this length instead of the owner of their hash, so runs
+    // of adjacent k-mers share a rank. The slot in the owner's partition
+    // still comes from the full hash.
+    int minimizer_len;
+
+    // Most k-mers find_run_async() brings back per lookup; 1 finds one
+    int find_depth;
+
+    // This rank's partition
+    Storage local;
+
+    // Lets handlers on other ranks reach this rank's map
+    upcxx::dist_object<HashMap*> self;
+
+    transport_type transport;
+
+    // Buffers used by insert() when the caller does not bring its own
+    SendBuffers own_buffers;
+
+    // Collective; every rank's partition starts with local_table_size1 slots
+    HashMap(size_t full_table_size1, size_t local_table_size1);
+
+    HashMap(const HashMap&) = delete;
+    HashMap& operator=(const HashMap&) = delete;
 
     // Most important functions: insert and retrieve
     // k-mers from the hash table.
     bool insert(const kmer_pair& kmer);
     bool find(const pkmer_t& key_kmer, kmer_pair& val_kmer);
 
+    // Thread-safe insert; each thread passes its own buffers.
+    bool insert(const kmer_pair& kmer, SendBuffers& buffers);
+
+    // Wait until what was inserted with the buffers is in place; false if
+    // any of it did not fit
+    bool send_all_buffers();
+    bool send_all_buffers(SendBuffers& buffers);
+
+    // Non-blocking lookup; the flag is false if the k-mer is not in the table.
+    upcxx::future<std::pair<bool, kmer_pair>> find_async(const pkmer_t& key_kmer);
+    // Non-blocking lookup of a k-mer and of the successors that live on
+    // the same rank, up to find_depth k-mers.
+    upcxx::future<kmer_run> find_run_async(const pkmer_t& key_kmer);
+    upcxx::future<kmer_run> lookup(const pkmer_t& key_kmer, int depth);
+
+    // Follow the contig from a k-mer this rank owns while its successors
+    // are owned here too, up to depth k-mers
+    kmer_run find_run(const pkmer_t& key_kmer, uint64_t hash, int depth) const;
+
     // Helper functions
 
-    // Write and read to a logical data slot in the table.
-    void write_slot(uint64_t slot, const kmer_pair& kmer);
-    kmer_pair read_slot(uint64_t slot);
+    uint64_t hash(const pkmer_t& kmer) const noexcept;
+
+    // Rank whose partition holds the k-mer, whose hash is given
+    int owner(const pkmer_t& kmer, uint64_t hash) const noexcept;
 
-    // Request a slot or check if it's already used.
-    bool request_slot(uint64_t slot);
-    bool slot_used(uint64_t slot);
+    // Look up a k-mer this rank owns
+    bool find_local(const pkmer_t& key_kmer, uint64_t hash, kmer_pair& val_kmer) const;
 };
 
-HashMap::HashMap(size_t size) {
-    my_size = size;
-    data.resize(size);
-    used.resize(size, 0);
+template <typename Storage, template <typename> class Transport, typename Hash>
+HashMap<Storage, Transport, Hash>::HashMap(size_t full_table_size1, size_t local_table_size1)
+    : full_table_size(full_table_size1), local_table_size(local_table_size1),
+      hasher(make_kmer_hash<Hash>()), minimizer_len(0), find_depth(FIND_RUN_DEPTH),
+      local(local_table_size1), self(this), transport(*this) {}
+
+template <typename Storage, template <typename> class Transport, typename Hash>
+bool HashMap<Storage, Transport, Hash>::insert(const kmer_pair& kmer) {
+    return insert(kmer, own_buffers);
 }
 
-bool HashMap::insert(const kmer_pair& kmer) {
-    uint64_t hash = kmer.hash();
-    uint64_t probe = 0;
-    bool success = false;
-    do {
-        uint64_t slot = (hash + probe++) % size();
-        success = request_slot(slot);
-        if (success) {
-            write_slot(slot, kmer);
-        }
-    } while (!success && probe < size());
-    return success;
+template <typename Storage, template <typename> class Transport, typename Hash>
+bool HashMap<Storage, Transport, Hash>::insert(const kmer_pair& kmer, SendBuffers& buffers) {
+    uint64_t kmer_hash = hash(kmer.kmer);
+    COUNT(counters().inserts++);
+    return transport.insert(kmer, kmer_hash, owner(kmer.kmer, kmer_hash), buffers);
+}
+
+template <typename Storage, template <typename> class Transport, typename Hash>
+bool HashMap<Storage, Transport, Hash>::send_all_buffers() {
+    return send_all_buffers(own_buffers);
 }
 
-bool HashMap::find(const pkmer_t& key_kmer, kmer_pair& val_kmer) {
-    uint64_t hash = key_kmer.hash();
-    uint64_t probe = 0;
-    bool success = false;
-    do {
-        uint64_t slot = (hash + probe++) % size();
-        if (slot_used(slot)) {
-            val_kmer = read_slot(slot);
-            if (val_kmer.kmer == key_kmer) {
-                success = true;
-            }
+template <typename Storage, template <typename> class Transport, typename Hash>
+bool HashMap<Storage, Transport, Hash>::send_all_buffers(SendBuffers& buffers) {
+    return transport.flush(buffers);
+}
+
+template <typename Storage, template <typename> class Transport, typename Hash>
+kmer_run HashMap<Storage, Transport, Hash>::find_run(const pkmer_t& key_kmer, uint64_t hash,
+                                                     int depth) const {
+    kmer_run run = {};
+    kmer_pair kmer;
+    if (!local.find(key_kmer, hash, kmer)) {
+        return run;
+    }
+
+    // The run ends at the end of the contig, at depth, or where the
+    // successor lives on another rank
+    for (int i = 1; i < depth && kmer.forwardExt() != 'F'; i++) {
+        pkmer_t next = kmer.next_kmer();
+        uint64_t next_hash = this->hash(next);
+        kmer_pair found;
+        if (owner(next, next_hash) != upcxx::rank_me() || !local.find(next, next_hash, found)) {
+            break;
         }
-    } while (!success && probe < size());
-    return success;
+        pack_base(run.packed, run.n_bases, kmer.forwardExt());
+        run.n_bases++;
+        kmer = found;
+    }
+    run.last = kmer_entry::pack(kmer);
+    return run;
 }
 
-bool HashMap::slot_used(uint64_t slot) { return used[slot] != 0; }
+template <typename Storage, template <typename> class Transport, typename Hash>
+upcxx::future<kmer_run> HashMap<Storage, Transport, Hash>::lookup(const pkmer_t& key_kmer,
+                                                                  int depth) {
+    uint64_t key_hash = hash(key_kmer);
+    int target_rank = owner(key_kmer, key_hash);
+
+    // Our own k-mers resolve immediately
+    if (target_rank == upcxx::rank_me()) {
+        COUNT(counters().local_finds++);
+        return upcxx::make_future(find_run(key_kmer, key_hash, depth));
+    }
+
+    COUNT(counters().remote_finds++; counters().count_rpc(target_rank, sizeof(pkmer_t)));
+    auto sent = std::chrono::steady_clock::now();
+    return transport.find(key_kmer, key_hash, target_rank, depth).then([sent](kmer_run run) {
+        COUNT(count_find_latency(sent));
+        return run;
+    });
+}
 
-void HashMap::write_slot(uint64_t slot, const kmer_pair& kmer) { data[slot] = kmer; }
+template <typename Storage, template <typename> class Transport, typename Hash>
+upcxx::future<kmer_run> HashMap<Storage, Transport, Hash>::find_run_async(const pkmer_t& key_kmer) {
+    return lookup(key_kmer, find_depth);
+}
 
-kmer_pair HashMap::read_slot(uint64_t slot) { return data[slot]; }
+template <typename Storage, template <typename> class Transport, typename Hash>
+upcxx::future<std::pair<bool, kmer_pair>>
+HashMap<Storage, Transport, Hash>::find_async(const pkmer_t& key_kmer) {
+    return lookup(key_kmer, 1).then([](const kmer_run& run) {
+        return std::make_pair(!run.last.empty(), run.last.unpack());
+    });
+}
 
-bool HashMap::request_slot(uint64_t slot) {
-    if (used[slot] != 0) {
-        return false;
-    } else {
-        used[slot] = 1;
-        return true;
+template <typename Storage, template <typename> class Transport, typename Hash>
+bool HashMap<Storage, Transport, Hash>::find(const pkmer_t& key_kmer, kmer_pair& val_kmer) {
+    TRACE_SPAN("find wait");
+    std::pair<bool, kmer_pair> result = find_async(key_kmer).wait();
+    val_kmer = result.second;
+    return result.first;
+}
+
+template <typename Storage, template <typename> class Transport, typename Hash>
+bool HashMap<Storage, Transport, Hash>::find_local(const pkmer_t& key_kmer, uint64_t hash,
+                                                   kmer_pair& val_kmer) const {
+    COUNT(counters().local_finds++);
+    return local.find(key_kmer, hash, val_kmer);
+}
+
+template <typename Storage, template <typename> class Transport, typename Hash>
+uint64_t HashMap<Storage, Transport, Hash>::hash(const pkmer_t& kmer) const noexcept {
+    return kmer.hash(hasher);
+}
+
+template <typename Storage, template <typename> class Transport, typename Hash>
+int HashMap<Storage, Transport, Hash>::owner(const pkmer_t& kmer, uint64_t hash) const noexcept {
+    if (minimizer_len != 0) {
+        hash = kmer.minimizer_hash(minimizer_len, hasher);
     }
+    return (hash % size()) / local_size();
 }
 
-size_t HashMap::size() const noexcept { return my_size; }
+template <typename Storage, template <typename> class Transport, typename Hash>
+size_t HashMap<Storage, Transport, Hash>::size() const noexcept {
+    return full_table_size;
+}
+
+template <typename Storage, template <typename> class Transport, typename Hash>
+size_t HashMap<Storage, Transport, Hash>::local_size() const noexcept {
+    return local_table_size;
+}
+
+// The strategies kmer_hash can run with, by KMER_TRANSPORT number and name
+#define KMER_TRANSPORT_SERIAL  0
+#define KMER_TRANSPORT_RPC     1
+#define KMER_TRANSPORT_ATOMIC  2
+#define KMER_TRANSPORT_MAILBOX 3
+
+const char* const transport_names[] = {"serial", "rpc", "atomic", "mailbox"};
+
+typedef HashMap<GrowableTable, SerialTransport> SerialHashMap;
+typedef HashMap<GrowableTable, RpcTransport> RpcHashMap;
+typedef HashMap<SharedSlots, AtomicTransport> AtomicHashMap;
+typedef HashMap<GrowableTable, MailboxTransport> MailboxHashMap;
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Hash functions over packed k-mer bytes. The hash picks both the owning
+// rank and the probe start in its partition, so it has to spread 2-bit
+// packed DNA evenly. Select the one pkmer_t::hash() uses with
+// -DKMER_HASH=KMER_HASH_DJB2 or KMER_HASH_MIX64, and its seed with
+// -DKMER_HASH_SEED=<n>.
+#define KMER_HASH_DJB2  0
+#define KMER_HASH_MIX64 1
+
+#ifndef KMER_HASH
+#define KMER_HASH KMER_HASH_MIX64
+#endif
+
+#ifndef KMER_HASH_SEED
+#define KMER_HASH_SEED 0
+#endif
+
+// The original byte-at-a-time djb2; the seed replaces the 5381 start value.
+struct Djb2Hash {
+    uint64_t seed;
+
+    Djb2Hash(uint64_t seed1 = 5381) : seed(seed1) {}
+
+    uint64_t operator()(const unsigned char* data, size_t len) const noexcept {
+        uint64_t hashval = seed;
+        for (size_t i = 0; i < len; i++) {
+            hashval = data[i] + (hashval << 5) + hashval;
+        }
+        return hashval;
+    }
+};
+
+// Consumes 8 bytes per step and finishes with the murmur3 64-bit mixer,
+// so every input bit affects every output bit.
+struct Mix64Hash {
+    uint64_t seed;
+
+    Mix64Hash(uint64_t seed1 = 0) : seed(seed1) {}
+
+    static uint64_t fmix64(uint64_t h) noexcept {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint64_t operator()(const unsigned char* data, size_t len) const noexcept {
+        const uint64_t k1 = 0x87c37b91114253d5ULL;
+        const uint64_t k2 = 0x4cf5ad432745937fULL;
+        uint64_t h = seed ^ (len * k2);
+
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            word *= k1;
+            word = (word << 31) | (word >> 33);
+            h ^= word * k2;
+            h = ((h << 27) | (h >> 37)) * 5 + 0x52dce729;
+        }
+
+        if (i < len) {
+            uint64_t word = 0;
+            for (size_t j = i; j < len; j++) {
+                word |= (uint64_t)data[j] << (8 * (j - i));
+            }
+            word *= k1;
+            word = (word << 31) | (word >> 33);
+            h ^= word * k2;
+        }
+
+        return fmix64(h);
+    }
+};
+
+#if KMER_HASH == KMER_HASH_DJB2
+typedef Djb2Hash DefaultKmerHash;
+#define DEFAULT_KMER_HASH_SEED (KMER_HASH_SEED ? KMER_HASH_SEED : 5381)
+#else
+typedef Mix64Hash DefaultKmerHash;
+#define DEFAULT_KMER_HASH_SEED KMER_HASH_SEED
+#endif
+
+// The hasher of a policy: for the default one the hasher pkmer_t::hash()
+// uses, for any other its default seed
+template <typename Hash> Hash make_kmer_hash() { return Hash(); }
+
+template <> DefaultKmerHash make_kmer_hash<DefaultKmerHash>() {
+    return DefaultKmerHash(DEFAULT_KMER_HASH_SEED);
+}
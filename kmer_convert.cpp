@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "kmer_gzip.hpp"
+#include "kmer_t.hpp"
+#include "read_kmers.hpp"
+#include "write_kmers.hpp"
+
+// Converts a text k-mer file to the binary format in read_kmers.hpp, with
+// the k-mers already packed. With -z it instead writes the block-compressed
+// text format in kmer_gzip.hpp. read_kmers() and friends accept every
+// format.
+//
+// usage: ./kmer_convert [-z] kmer_file out_file
+
+int main(int argc, char** argv) {
+    bool compress = argc >= 2 && std::string(argv[1]) == "-z";
+    if (compress) {
+        argv++;
+        argc--;
+    }
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: ./kmer_convert [-z] kmer_file out_file\n");
+        return 1;
+    }
+    std::string in_fname = argv[1];
+    std::string out_fname = argv[2];
+
+    int ks = kmer_size(in_fname);
+    if (ks != KMER_LEN) {
+        fprintf(stderr, "Error: %s contains %d-mers, while this binary is compiled for %d-mers.\n",
+                in_fname.c_str(), ks, KMER_LEN);
+        return 1;
+    }
+
+    if (compress) {
+        try {
+            KgzFooter footer = compress_kmers(in_fname, out_fname);
+            printf("Compressed %zu lines of %s into %zu blocks, %zu bytes.\n",
+                   (size_t)footer.n_kmers, in_fname.c_str(), (size_t)footer.n_blocks,
+                   (size_t)footer.index_offset);
+        } catch (const std::runtime_error& e) {
+            fprintf(stderr, "Error: %s\n", e.what());
+            return 1;
+        }
+        return 0;
+    }
+
+    std::vector<kmer_pair> kmers = read_kmers(in_fname);
+    try {
+        write_binary_kmers(out_fname, kmers);
+    } catch (const std::runtime_error& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+
+    printf("Wrote %zu %d-mers to %s (%zu bytes per record).\n", kmers.size(), KMER_LEN,
+           out_fname.c_str(), sizeof(kmer_pair));
+    return 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "kmer_t.hpp"
+
+// Compact table entries. For K <= 29 a k-mer and its two extensions fit in
+// one uint64_t, for K <= 61 in one __uint128_t:
+//
+//     [ 2K bits of k-mer, first base highest | 3-bit backward | 3-bit forward ]
+//
+// Extension codes start at 1 (A=1, C=2, G=3, T=4, F=5), so a stored entry is
+// never 0 and 0 can mean "empty". Keys compare as one integer compare of
+// the bits above the extensions. Larger K falls back to a whole kmer_pair.
+//
+// Every entry type has the same interface:
+//     static kmer_entry pack(const kmer_pair&);
+//     kmer_pair unpack() const;  pkmer_t kmer() const;
+//     static key_type key(const pkmer_t&);  bool has_key(const key_type&) const;
+//     bool empty() const;
+
+struct ExtCodeTable {
+    unsigned char code[256];
+};
+
+constexpr ExtCodeTable make_ExtCodeTable() {
+    ExtCodeTable table{};
+    table.code['A'] = 1;
+    table.code['C'] = 2;
+    table.code['G'] = 3;
+    table.code['T'] = 4;
+    table.code['F'] = 5;
+    return table;
+}
+
+constexpr ExtCodeTable extToCode = make_ExtCodeTable();
+constexpr char codeToExt[8] = {0, 'A', 'C', 'G', 'T', 'F', 0, 0};
+
+template <typename Word> struct WordEntry {
+    typedef Word key_type;
+
+    static constexpr int EXT_BITS = 6;
+    // Padding bits at the end of the packed bytes
+    static constexpr int PAD_BITS = 2 * (4 * PACKED_KMER_LEN - KMER_LEN);
+
+    static_assert(2 * KMER_LEN + EXT_BITS <= 8 * sizeof(Word), "k-mer does not fit in the entry");
+
+    Word word;
+
+    static WordEntry pack(const kmer_pair& kmer) noexcept;
+    kmer_pair unpack() const noexcept;
+    pkmer_t kmer() const noexcept;
+
+    static key_type key(const pkmer_t& kmer) noexcept;
+    bool has_key(const key_type& key) const noexcept { return (word >> EXT_BITS << EXT_BITS) == key; }
+    bool empty() const noexcept { return word == 0; }
+};
+
+template <typename Word> Word WordEntry<Word>::key(const pkmer_t& kmer) noexcept {
+    Word value = 0;
+    for (int i = 0; i < PACKED_KMER_LEN; i++) {
+        value = (value << 8) | kmer.data[i];
+    }
+    return value >> PAD_BITS << EXT_BITS;
+}
+
+template <typename Word> WordEntry<Word> WordEntry<Word>::pack(const kmer_pair& kmer) noexcept {
+    WordEntry entry;
+    entry.word = key(kmer.kmer) | (extToCode.code[(unsigned char)kmer.backwardExt()] << 3) |
+                 extToCode.code[(unsigned char)kmer.forwardExt()];
+    return entry;
+}
+
+template <typename Word> pkmer_t WordEntry<Word>::kmer() const noexcept {
+    pkmer_t kmer;
+    Word value = word >> EXT_BITS << PAD_BITS;
+    for (int i = PACKED_KMER_LEN - 1; i >= 0; i--) {
+        kmer.data[i] = (unsigned char)value;
+        value >>= 8;
+    }
+    return kmer;
+}
+
+template <typename Word> kmer_pair WordEntry<Word>::unpack() const noexcept {
+    kmer_pair kmer;
+    kmer.kmer = this->kmer();
+    kmer.fb_ext[0] = codeToExt[(word >> 3) & 7];
+    kmer.fb_ext[1] = codeToExt[word & 7];
+    return kmer;
+}
+
+// Entry for K > 61: the kmer_pair itself, empty while it has no extensions.
+struct PairEntry {
+    typedef pkmer_t key_type;
+
+    kmer_pair pair;
+
+    static PairEntry pack(const kmer_pair& kmer) noexcept { return PairEntry{kmer}; }
+    kmer_pair unpack() const noexcept { return pair; }
+    pkmer_t kmer() const noexcept { return pair.kmer; }
+
+    static key_type key(const pkmer_t& kmer) noexcept { return kmer; }
+    bool has_key(const key_type& key) const noexcept { return pair.kmer == key; }
+    bool empty() const noexcept { return pair.fb_ext[0] == 0; }
+};
+
+#if KMER_LEN <= 29
+typedef WordEntry<uint64_t> kmer_entry;
+#elif KMER_LEN <= 61
+typedef WordEntry<__uint128_t> kmer_entry;
+#else
+typedef PairEntry kmer_entry;
+#endif
+
+// What the insert batches carry: a kmer_entry without its padding bits,
+// 2K + 6 bits rounded up to whole bytes. That is 6 bytes for K=19 and 14 for
+// K=51, against 7 and 15 for a kmer_pair and 8 and 16 for the entry. The
+// bytes are the low bytes of the word, so this needs a little-endian host.
+// For K > 61 it is the kmer_pair, which has no padding to drop.
+template <typename Entry, int N_BYTES> struct WireEntry {
+    unsigned char bytes[N_BYTES];
+
+    static WireEntry pack(const Entry& entry) noexcept {
+        WireEntry wire;
+        memcpy(wire.bytes, &entry, N_BYTES);
+        return wire;
+    }
+    Entry unpack() const noexcept {
+        Entry entry{};
+        memcpy(&entry, bytes, N_BYTES);
+        return entry;
+    }
+};
+
+#if KMER_LEN <= 61
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "wire_entry needs a little-endian host");
+typedef WireEntry<kmer_entry, (2 * KMER_LEN + kmer_entry::EXT_BITS + 7) / 8> wire_entry;
+#else
+typedef WireEntry<kmer_entry, sizeof(kmer_entry)> wire_entry;
+#endif
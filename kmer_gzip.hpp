@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+// Block-compressed k-mer files. The text is cut at line boundaries into
+// blocks of at most KGZ_BLOCK_BYTES, each compressed as its own gzip member,
+// so every block can be inflated without the ones before it. After the
+// blocks comes an index with one KgzBlock per block, then a KgzFooter
+// at the very end of the file:
+//
+//     [gzip member] ... [gzip member] [KgzBlock x n_blocks] [KgzFooter]
+//
+// A rank reads the footer and index, then inflates only its own blocks.
+// zcat still decompresses the whole file, but it warns about the
+// trailing index.
+#define KGZ_MAGIC "KMERGZX1"
+
+// Uncompressed bytes per block
+#define KGZ_BLOCK_BYTES (1 << 20)
+
+struct KgzBlock {
+    uint64_t offset;
+    // Lines before this block
+    uint64_t first_kmer;
+    uint32_t size;
+    uint32_t raw_size;
+};
+
+struct KgzFooter {
+    uint64_t index_offset;
+    uint64_t n_blocks;
+    uint64_t n_kmers;
+    char magic[8];
+};
+
+// Fill footer from the end of a file; false if it is not block-compressed
+bool parse_kgz_footer(const char* data, size_t size, KgzFooter& footer) {
+    if (size < sizeof(KgzFooter)) {
+        return false;
+    }
+    memcpy(&footer, data + size - sizeof(KgzFooter), sizeof(KgzFooter));
+    return memcmp(footer.magic, KGZ_MAGIC, 8) == 0 &&
+           footer.index_offset + footer.n_blocks * sizeof(KgzBlock) + sizeof(KgzFooter) == size;
+}
+
+bool read_kgz_footer(const std::string& fname, KgzFooter& footer) {
+    FILE* f = fopen(fname.c_str(), "rb");
+    if (f == NULL) {
+        throw std::runtime_error("could not open " + fname);
+    }
+    bool found = fseek(f, -(long)sizeof(KgzFooter), SEEK_END) == 0 &&
+                 fread(&footer, sizeof(KgzFooter), 1, f) == 1 &&
+                 memcmp(footer.magic, KGZ_MAGIC, 8) == 0;
+    fclose(f);
+    return found;
+}
+
+// Entry i of the index of a block-compressed file held in data
+KgzBlock kgz_block(const char* data, const KgzFooter& footer, size_t i) {
+    KgzBlock block;
+    memcpy(&block, data + footer.index_offset + i * sizeof(KgzBlock), sizeof(KgzBlock));
+    return block;
+}
+
+// Blocks [first, last) of rank's share
+void kgz_rank_blocks(const KgzFooter& footer, int nprocs, int rank, size_t& first, size_t& last) {
+    first = footer.n_blocks * rank / nprocs;
+    last = footer.n_blocks * (rank + 1) / nprocs;
+}
+
+// Inflate one gzip member of size bytes into exactly raw_size bytes of out
+void inflate_block(const char* in, size_t size, char* out, size_t raw_size) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        throw std::runtime_error("inflate_block: could not initialize zlib");
+    }
+    stream.next_in = (Bytef*)in;
+    stream.avail_in = size;
+    stream.next_out = (Bytef*)out;
+    stream.avail_out = raw_size;
+
+    int status = inflate(&stream, Z_FINISH);
+    size_t produced = stream.total_out;
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END || produced != raw_size) {
+        throw std::runtime_error("inflate_block: corrupt block");
+    }
+}
+
+// Compress size bytes of in as one gzip member
+std::vector<char> deflate_block(const char* in, size_t size, int level) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("deflate_block: could not initialize zlib");
+    }
+    std::vector<char> out(deflateBound(&stream, size));
+    stream.next_in = (Bytef*)in;
+    stream.avail_in = size;
+    stream.next_out = (Bytef*)out.data();
+    stream.avail_out = out.size();
+
+    int status = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        throw std::runtime_error("deflate_block: compression failed");
+    }
+    return out;
+}
@@ -1,87 +1,132 @@
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
-#include <list>
+#include <memory>
 #include <numeric>
 #include <set>
 #include <upcxx/upcxx.hpp>
 #include <vector>
 
+#include "butil.hpp"
+#include "contig.hpp"
+#include "contig_writer.hpp"
+#include "counters.hpp"
 #include "hash_map.hpp"
+#include "kmer_stream.hpp"
 #include "kmer_t.hpp"
+#include "migrating_traversal.hpp"
 #include "read_kmers.hpp"
+#include "threads.hpp"
+#include "trace.hpp"
+#include "traversal.hpp"
 
-#include "butil.hpp"
+#include <iostream>
 
-int main(int argc, char** argv) {
-    upcxx::init();
+// -DKMER_TRANSPORT=KMER_TRANSPORT_<NAME> builds in that transport alone.
+// Otherwise all of them are built in, and the KMER_TRANSPORT environment
+// variable picks one at run time: serial, rpc (the default), atomic or mailbox.
+#ifdef KMER_TRANSPORT
+#define WITH_TRANSPORT(id) (KMER_TRANSPORT == (id))
+#define DEFAULT_TRANSPORT KMER_TRANSPORT
+#else
+#define WITH_TRANSPORT(id) 1
+#define DEFAULT_TRANSPORT KMER_TRANSPORT_RPC
+#endif
 
-    // TODO: Dear Students,
-    // Please remove this if statement, when you start writing your parallel implementation.
-    if (upcxx::rank_n() > 1) {
-        throw std::runtime_error("Error: parallel implementation not started yet!"
-                                 " (remove this when you start working.)");
-    }
+template <typename Map>
+void assemble(const std::string& kmer_fname, const std::string& run_type,
+              const std::string& test_prefix) {
+    // Partitions grow as they fill, so a size-based estimate is enough
+    size_t n_kmers = kmer_count_estimate(kmer_fname);
 
-    if (argc < 2) {
-        BUtil::print("usage: srun -N nodes -n ranks ./kmer_hash kmer_file [verbose|test [prefix]]\n");
-        upcxx::finalize();
-        exit(1);
-    }
+    // Load factor of 0.85; the group-probed local tables stay short at that load
+    size_t hash_table_size = n_kmers * (1.0 / MAX_LOAD_FACTOR);
+    int num_procs = upcxx::rank_n();
+    int n_threads = threads_per_rank();
 
-    std::string kmer_fname = std::string(argv[1]);
-    std::string run_type = "";
+    // Size of each processor's hash table
+    size_t proc_hash_table_size = hash_table_size / num_procs + 1;
 
-    if (argc >= 3) {
-        run_type = std::string(argv[2]);
-    }
+    // Instantiate the hash table, with this rank's partition
+    Map hashmap(hash_table_size, proc_hash_table_size);
 
-    std::string test_prefix = "test";
-    if (run_type == "test" && argc >= 4) {
-        test_prefix = std::string(argv[3]);
+    // KMER_MINIMIZER=1 gives each k-mer to the owner of its minimizer, so
+    // most traversal steps stay on one rank; KMER_MINIMIZER_LEN sets m
+    if (BUtil::env_int("KMER_MINIMIZER", 0) != 0) {
+        hashmap.minimizer_len = BUtil::env_int("KMER_MINIMIZER_LEN", MINIMIZER_LEN);
+        if (hashmap.minimizer_len < 1 || hashmap.minimizer_len > std::min(KMER_LEN, 32)) {
+            throw std::runtime_error("Error: KMER_MINIMIZER_LEN must be between 1 and " +
+                                     std::to_string(std::min(KMER_LEN, 32)) + ".");
+        }
     }
-
-    int ks = kmer_size(kmer_fname);
-
-    if (ks != KMER_LEN) {
-        throw std::runtime_error("Error: " + kmer_fname + " contains " + std::to_string(ks) +
-                                 "-mers, while this binary is compiled for " +
-                                 std::to_string(KMER_LEN) +
-                                 "-mers.  Modify packing.hpp and recompile.");
+    if (run_type == "verbose") {
+        BUtil::print("Initializing hash table of size %zu for %zu kmers.\n", hash_table_size,
+                     n_kmers);
     }
 
-    size_t n_kmers = line_count(kmer_fname);
+    // KMER_STREAM=1 reads the input in chunks while inserting, instead of
+    // reading it all first; the insert time then includes the reading
+    bool streaming = BUtil::env_int("KMER_STREAM", 0) != 0;
 
-    // Load factor of 0.5
-    size_t hash_table_size = n_kmers * (1.0 / 0.5);
-    HashMap hashmap(hash_table_size);
+    std::vector<kmer_pair> kmers;
+    if (!streaming) {
+        TRACE_PHASE("read");
+        kmers = read_kmers(kmer_fname, upcxx::rank_n(), upcxx::rank_me());
 
-    if (run_type == "verbose") {
-        BUtil::print("Initializing hash table of size %d for %d kmers.\n", hash_table_size,
-                     n_kmers);
+        if (run_type == "verbose") {
+            BUtil::print("Finished reading kmers.\n");
+        }
     }
+    auto start = std::chrono::high_resolution_clock::now();
 
-    std::vector<kmer_pair> kmers = read_kmers(kmer_fname, upcxx::rank_n(), upcxx::rank_me());
-
-    if (run_type == "verbose") {
-        BUtil::print("Finished reading kmers.\n");
+    std::unique_ptr<KmerStream> stream;
+    if (streaming) {
+        stream.reset(new KmerStream(kmer_fname, upcxx::rank_n(), upcxx::rank_me()));
     }
 
-    auto start = std::chrono::high_resolution_clock::now();
+    // Each thread inserts a contiguous share of the k-mers with its own
+    // buffers, or takes chunks from the stream as they are parsed
+    std::vector<std::vector<kmer_pair>> thread_start_nodes(n_threads);
 
-    std::vector<kmer_pair> start_nodes;
+    run_on_threads(n_threads, [&](int tid) {
+        TRACE_PHASE("insert");
+        typename Map::SendBuffers buffers;
 
-    for (auto& kmer : kmers) {
-        bool success = hashmap.insert(kmer);
-        if (!success) {
-            throw std::runtime_error("Error: HashMap is full!");
+        auto insert_kmers = [&](const kmer_pair* first, const kmer_pair* last) {
+            for (const kmer_pair* kmer = first; kmer != last; kmer++) {
+                bool success = hashmap.insert(*kmer, buffers);
+                if (!success) {
+                    throw std::runtime_error("Error: HashMap is full!");
+                }
+
+                if (kmer->backwardExt() == 'F') {
+                    thread_start_nodes[tid].push_back(*kmer);
+                }
+            }
+        };
+
+        if (streaming) {
+            std::vector<kmer_pair> chunk;
+            while (stream->next(chunk, []() { upcxx::progress(); })) {
+                insert_kmers(chunk.data(), chunk.data() + chunk.size());
+            }
+        } else {
+            size_t share = (kmers.size() + n_threads - 1) / n_threads;
+            size_t first = std::min(kmers.size(), share * tid);
+            size_t last = std::min(kmers.size(), first + share);
+            insert_kmers(kmers.data() + first, kmers.data() + last);
         }
 
-        if (kmer.backwardExt() == 'F') {
-            start_nodes.push_back(kmer);
+        // Flush the partially filled buffers and wait for the owners to insert them
+        bool flushed = hashmap.send_all_buffers(buffers);
+        if (!flushed) {
+            throw std::runtime_error("Error: HashMap is full!");
         }
-    }
+    });
+    traced_barrier();
+
     auto end_insert = std::chrono::high_resolution_clock::now();
     upcxx::barrier();
 
@@ -91,25 +136,52 @@ int main(int argc, char** argv) {
     }
     upcxx::barrier();
 
+    // Test runs write the contigs to one shared file as they finish.
+    // KMER_FLUSH_LINES=1 writes every contig on its own instead of in chunks.
+    std::unique_ptr<ContigWriter> output;
+    if (run_type == "test") {
+        output.reset(new ContigWriter(test_prefix + ".dat",
+                                      BUtil::env_int("KMER_FLUSH_LINES", 0) != 0));
+    }
+
     auto start_read = std::chrono::high_resolution_clock::now();
 
-    std::list<std::list<kmer_pair>> contigs;
-    for (const auto& start_kmer : start_nodes) {
-        std::list<kmer_pair> contig;
-        contig.push_back(start_kmer);
-        while (contig.back().forwardExt() != 'F') {
-            kmer_pair kmer;
-            bool success = hashmap.find(contig.back().next_kmer(), kmer);
-            if (!success) {
-                throw std::runtime_error("Error: k-mer not found in hashmap.");
-            }
-            contig.push_back(kmer);
+    std::vector<kmer_pair> start_nodes;
+    for (int tid = 0; tid < n_threads; tid++) {
+        start_nodes.insert(start_nodes.end(), thread_start_nodes[tid].begin(),
+                           thread_start_nodes[tid].end());
+    }
+
+    // The rank's threads share its start nodes, and idle ranks steal the
+    // ones not yet walked. KMER_STEAL=0 keeps every start node where it was read.
+    WorkQueue queue(start_nodes, BUtil::env_int("KMER_STEAL", 1) != 0);
+
+    // KMER_MIGRATE=1 moves each walk to the owners of its k-mers instead of
+    // fetching the k-mers to the walk
+    bool migrating = BUtil::env_int("KMER_MIGRATE", 0) != 0;
+
+    // A remote lookup follows the contig on the owner for up to
+    // KMER_FIND_DEPTH k-mers; 1 fetches one k-mer per round trip
+    hashmap.find_depth = BUtil::env_int("KMER_FIND_DEPTH", FIND_RUN_DEPTH);
+
+    // Walk many contigs at once so remote lookups overlap, on every thread
+    std::vector<ContigSet> thread_contigs(n_threads);
+    run_on_threads(n_threads, [&](int tid) {
+        TRACE_PHASE("traverse");
+        if (migrating) {
+            thread_contigs[tid] = traverse_migrating(hashmap.self, queue, output.get());
+        } else {
+            thread_contigs[tid] = traverse_async(hashmap, queue, output.get());
         }
-        contigs.push_back(contig);
+    });
+
+    ContigSet contigs;
+    for (int tid = 0; tid < n_threads; tid++) {
+        contigs.splice(thread_contigs[tid]);
     }
 
     auto end_read = std::chrono::high_resolution_clock::now();
-    upcxx::barrier();
+    traced_barrier();
     auto end = std::chrono::high_resolution_clock::now();
 
     std::chrono::duration<double> read = end_read - start_read;
@@ -118,27 +190,111 @@ int main(int argc, char** argv) {
 
     int numKmers = std::accumulate(
         contigs.begin(), contigs.end(), 0,
-        [](int sum, const std::list<kmer_pair>& contig) { return sum + contig.size(); });
+        [](int sum, const Contig& contig) { return sum + contig.size(); });
 
     if (run_type != "test") {
         BUtil::print("Assembled in %lf total\n", total.count());
     }
 
     if (run_type == "verbose") {
-        printf("Rank %d reconstructed %d contigs with %d nodes from %d start nodes."
+        printf("Rank %d reconstructed %zu contigs with %d nodes from %zu start nodes."
                " (%lf read, %lf insert, %lf total)\n",
                upcxx::rank_me(), contigs.size(), numKmers, start_nodes.size(), read.count(),
                insert.count(), total.count());
+        printf("Rank %d holds %zu k-mers in %zu slots after growing %d times.\n", upcxx::rank_me(),
+               hashmap.local.size(), hashmap.local.capacity(), hashmap.local.n_grows);
+    }
+
+    // Counters and timings over all ranks, to spot stragglers and hot owners
+    if (run_type == "verbose") {
+        fflush(stdout);
+        upcxx::barrier();
+        report_counters({{"insert seconds", insert.count()},
+                         {"traversal seconds", read.count()},
+                         {"total seconds", total.count()},
+                         {"k-mers held", double(hashmap.local.size())}});
     }
 
     if (run_type == "test") {
-        std::ofstream fout(test_prefix + "_" + std::to_string(upcxx::rank_me()) + ".dat");
-        for (const auto& contig : contigs) {
-            fout << extract_contig(contig) << std::endl;
-        }
-        fout.close();
+        TRACE_PHASE("write output");
+        output->close();
+    }
+
+    // Nobody may still be reaching into this rank's partition when it goes
+    upcxx::barrier();
+}
+
+int main(int argc, char** argv) {
+    upcxx::init();
+
+    if (argc < 2) {
+        BUtil::print("usage: srun -N nodes -n ranks ./kmer_hash kmer_file [verbose|test [prefix]]\n");
+        upcxx::finalize();
+        exit(1);
+    }
+
+    // KMER_TRACE=1 writes a trace_<rank>.json timeline of each rank
+    trace_init();
+
+    std::string kmer_fname = std::string(argv[1]);
+    std::string run_type = "";
+
+    if (argc >= 3) {
+        run_type = std::string(argv[2]);
+    }
+
+    std::string test_prefix = "test";
+    if (run_type == "test" && argc >= 4) {
+        test_prefix = std::string(argv[3]);
+    }
+
+    int ks = kmer_size(kmer_fname);
+
+    if (ks != KMER_LEN) {
+        throw std::runtime_error("Error: " + kmer_fname + " contains " + std::to_string(ks) +
+                                 "-mers, while this binary is compiled for " +
+                                 std::to_string(KMER_LEN) +
+                                 "-mers.  Modify packing.hpp and recompile.");
     }
 
+    std::string transport =
+        BUtil::env_string("KMER_TRANSPORT", transport_names[DEFAULT_TRANSPORT]);
+    if (run_type == "verbose") {
+        BUtil::print("Using the %s transport.\n", transport.c_str());
+    }
+
+    bool assembled = false;
+#if WITH_TRANSPORT(KMER_TRANSPORT_SERIAL)
+    if (transport == transport_names[KMER_TRANSPORT_SERIAL]) {
+        assemble<SerialHashMap>(kmer_fname, run_type, test_prefix);
+        assembled = true;
+    }
+#endif
+#if WITH_TRANSPORT(KMER_TRANSPORT_RPC)
+    if (transport == transport_names[KMER_TRANSPORT_RPC]) {
+        assemble<RpcHashMap>(kmer_fname, run_type, test_prefix);
+        assembled = true;
+    }
+#endif
+#if WITH_TRANSPORT(KMER_TRANSPORT_ATOMIC)
+    if (transport == transport_names[KMER_TRANSPORT_ATOMIC]) {
+        assemble<AtomicHashMap>(kmer_fname, run_type, test_prefix);
+        assembled = true;
+    }
+#endif
+#if WITH_TRANSPORT(KMER_TRANSPORT_MAILBOX)
+    if (transport == transport_names[KMER_TRANSPORT_MAILBOX]) {
+        assemble<MailboxHashMap>(kmer_fname, run_type, test_prefix);
+        assembled = true;
+    }
+#endif
+    if (!assembled) {
+        throw std::runtime_error("Error: KMER_TRANSPORT=" + transport +
+                                 " is not a transport this binary was built with.");
+    }
+
+    trace_dump();
     upcxx::finalize();
+
     return 0;
 }
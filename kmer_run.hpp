@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "kmer_entry.hpp"
+
+// What a lookup returns: the k-mers of a contig found in a row on their
+// owner, as the last of them plus the bases the others add, packed four to
+// a byte. An empty last means the first k-mer was not found.
+struct kmer_run {
+    kmer_entry last;
+    uint32_t n_bases;
+    std::vector<unsigned char> packed;
+
+    UPCXX_SERIALIZED_FIELDS(last, n_bases, packed)
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "kmer_gzip.hpp"
+#include "kmer_t.hpp"
+#include "read_kmers.hpp"
+#include "trace.hpp"
+
+// K-mers per chunk handed to the inserters
+#define STREAM_CHUNK 65536
+
+// Parsed chunks allowed to wait for an inserter
+#define STREAM_DEPTH 4
+
+// Streams one rank's share of a k-mer file: text, binary or
+// block-compressed. A background thread parses (or copies, or inflates and
+// parses) the mapping chunk by chunk, at most STREAM_DEPTH chunks ahead of
+// the inserters, and drops the pages it has finished with, so input memory
+// stays at a few chunks however large the file is. Chunk buffers are
+// recycled between the reader and the inserters.
+//
+// The reader thread makes no UPC++ calls. next() may be called from
+// several threads at once.
+struct KmerStream {
+    MappedFile file;
+    bool binary;
+    bool compressed;
+
+    // Text and binary files: the bytes still to read
+    const char* next_byte;
+    const char* stop;
+
+    // Compressed files: the blocks still to read
+    KgzFooter footer;
+    size_t next_block;
+    size_t last_block;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<std::vector<kmer_pair>> ready;
+    std::vector<std::vector<kmer_pair>> spare;
+    bool stopping;
+    bool done;
+    std::exception_ptr error;
+
+    std::thread reader;
+
+    KmerStream(const std::string& fname, int nprocs = 1, int rank = 0);
+    ~KmerStream();
+
+    // Swap the next parsed chunk into chunk, returning false once the input
+    // is exhausted. Calls idle() while no chunk is ready, so a caller can
+    // keep serving RPCs. chunk's old buffer is reused for later chunks.
+    template <typename F> bool next(std::vector<kmer_pair>& chunk, F idle);
+
+    void read_all();
+    void read_bytes();
+    void read_blocks();
+
+    // Reader side: wait until a chunk may be queued, taking a spare buffer
+    // for it; false if the stream is being torn down.
+    bool wait_for_room(std::vector<kmer_pair>& chunk);
+    void publish(std::vector<kmer_pair>& chunk);
+
+    // Let the kernel reclaim the whole pages of [from, to)
+    void drop_pages(const char* from, const char* to);
+};
+
+KmerStream::KmerStream(const std::string& fname, int nprocs, int rank) : file(fname) {
+    size_t first = 0, last = 0;
+    compressed = parse_kgz_footer(file.data, file.size, footer);
+    if (compressed) {
+        binary = false;
+        kgz_rank_blocks(footer, nprocs, rank, next_block, last_block);
+        if (next_block < last_block) {
+            first = kgz_block(file.data, footer, next_block).offset;
+            last = last_block < footer.n_blocks ? kgz_block(file.data, footer, last_block).offset
+                                                : footer.index_offset;
+        }
+    } else {
+        binary = rank_range(file, nprocs, rank, first, last);
+    }
+    next_byte = file.data + first;
+    stop = file.data + last;
+    stopping = false;
+    done = false;
+
+    if (first < last) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t aligned = first / page * page;
+        madvise((void*)(file.data + aligned), last - aligned, MADV_SEQUENTIAL);
+    }
+
+    reader = std::thread([this]() { read_all(); });
+}
+
+KmerStream::~KmerStream() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        changed.notify_all();
+    }
+    reader.join();
+}
+
+void KmerStream::read_all() {
+    try {
+        if (compressed) {
+            read_blocks();
+        } else {
+            read_bytes();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> guard(lock);
+        error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    done = true;
+    changed.notify_all();
+}
+
+void KmerStream::read_bytes() {
+    while (next_byte < stop) {
+        std::vector<kmer_pair> chunk;
+        if (!wait_for_room(chunk)) {
+            return;
+        }
+
+        TRACE_SPAN("parse chunk");
+        chunk.resize(STREAM_CHUNK);
+        size_t n;
+        const char* from = next_byte;
+        if (binary) {
+            n = std::min<size_t>(STREAM_CHUNK, (stop - from) / sizeof(kmer_pair));
+            memcpy((void*)chunk.data(), from, n * sizeof(kmer_pair));
+            next_byte = from + n * sizeof(kmer_pair);
+        } else {
+            next_byte = parse_kmers(from, stop, chunk.data(), STREAM_CHUNK, n);
+        }
+        chunk.resize(n);
+
+        drop_pages(from, next_byte);
+        publish(chunk);
+    }
+}
+
+void KmerStream::read_blocks() {
+    std::vector<char> raw;
+    for (; next_block < last_block; next_block++) {
+        std::vector<kmer_pair> chunk;
+        if (!wait_for_room(chunk)) {
+            return;
+        }
+
+        TRACE_SPAN("inflate block");
+        KgzBlock block = kgz_block(file.data, footer, next_block);
+        uint64_t end_kmer = next_block + 1 < footer.n_blocks
+                                ? kgz_block(file.data, footer, next_block + 1).first_kmer
+                                : footer.n_kmers;
+
+        read_kgz_block(file.data, footer, next_block, raw);
+        chunk.resize(end_kmer - block.first_kmer);
+        size_t n;
+        parse_kmers(raw.data(), raw.data() + raw.size(), chunk.data(), chunk.size(), n);
+        chunk.resize(n);
+
+        drop_pages(file.data + block.offset, file.data + block.offset + block.size);
+        publish(chunk);
+    }
+}
+
+bool KmerStream::wait_for_room(std::vector<kmer_pair>& chunk) {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this]() { return ready.size() < STREAM_DEPTH || stopping; });
+    if (stopping) {
+        return false;
+    }
+    if (!spare.empty()) {
+        chunk.swap(spare.back());
+        spare.pop_back();
+    }
+    return true;
+}
+
+void KmerStream::publish(std::vector<kmer_pair>& chunk) {
+    std::lock_guard<std::mutex> guard(lock);
+    ready.push_back(std::move(chunk));
+    changed.notify_all();
+}
+
+void KmerStream::drop_pages(const char* from, const char* to) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t drop_first = (from - file.data + page - 1) / page * page;
+    size_t drop_last = (to - file.data) / page * page;
+    if (drop_first < drop_last) {
+        madvise((void*)(file.data + drop_first), drop_last - drop_first, MADV_DONTNEED);
+    }
+}
+
+template <typename F> bool KmerStream::next(std::vector<kmer_pair>& chunk, F idle) {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!ready.empty()) {
+                chunk.clear();
+                spare.push_back(std::move(chunk));
+                chunk.swap(ready.front());
+                ready.erase(ready.begin());
+                changed.notify_all();
+                return true;
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            if (done) {
+                return false;
+            }
+        }
+        idle();
+    }
+}
@@ -48,13 +48,9 @@ std::string kmer_pair::kmer_str() const noexcept { return kmer.get(); }
 
 std::string kmer_pair::fb_ext_str() const noexcept { return std::string(fb_ext, 2); }
 
-pkmer_t kmer_pair::next_kmer() const noexcept {
-    return pkmer_t(kmer_str().substr(1, std::string::npos) + forwardExt());
-}
+pkmer_t kmer_pair::next_kmer() const noexcept { return kmer.shift_left(forwardExt()); }
 
-pkmer_t kmer_pair::last_kmer() const noexcept {
-    return pkmer_t(backwardExt() + kmer_str().substr(0, kmer_str().length() - 1));
-}
+pkmer_t kmer_pair::last_kmer() const noexcept { return kmer.shift_right(backwardExt()); }
 
 void kmer_pair::print() const noexcept {
     printf("%s %s\n", kmer_str().c_str(), fb_ext_str().c_str());
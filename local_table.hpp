@@ -0,0 +1,553 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "counters.hpp"
+#include "kmer_entry.hpp"
+#include "kmer_t.hpp"
+
+// Slots per group; one SIMD compare checks a whole group
+#define GROUP_WIDTH 16
+
+// Groups probed before a k-mer goes to the stash
+#define MAX_PROBE_GROUPS 16
+
+// Overflow entries per partition
+#define STASH_SIZE 256
+
+// Slot storage: kmer_pair records, keys and extensions in separate arrays,
+// or one compact kmer_entry per slot (see kmer_entry.hpp)
+#define TABLE_LAYOUT_PAIRS 0
+#define TABLE_LAYOUT_SPLIT 1
+#define TABLE_LAYOUT_ENTRY 2
+
+#ifndef TABLE_LAYOUT
+#if KMER_LEN <= 61
+#define TABLE_LAYOUT TABLE_LAYOUT_ENTRY
+#else
+#define TABLE_LAYOUT TABLE_LAYOUT_SPLIT
+#endif
+#endif
+
+#define CACHE_LINE 64
+
+// Entries per slot a partition holds before it grows
+#define MAX_LOAD_FACTOR 0.85
+
+// Groups of the old table moved to the new one per insert while growing
+#define MIGRATE_GROUPS 2
+
+// Allocator that starts every array on a cache line
+template <typename T> struct CacheAlignedAllocator {
+    typedef T value_type;
+
+    CacheAlignedAllocator() = default;
+    template <typename U> CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        size_t bytes = (n * sizeof(T) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+        void* ptr = std::aligned_alloc(CACHE_LINE, bytes);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return (T*)ptr;
+    }
+    void deallocate(T* ptr, size_t) { std::free(ptr); }
+
+    template <typename U> bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T> using aligned_vector = std::vector<T, CacheAlignedAllocator<T>>;
+
+// Every layout takes and returns kmer_entry values and looks slots up by
+// key_type, which is whatever make_key() turns a packed k-mer into.
+
+// Whole kmer_pair records, one per slot.
+struct PairSlots {
+    typedef pkmer_t key_type;
+
+    aligned_vector<kmer_pair> pairs;
+
+    void resize(size_t n) { pairs.resize(n); }
+    size_t size() const noexcept { return pairs.size(); }
+
+    static key_type make_key(const pkmer_t& kmer) noexcept { return kmer; }
+    bool has_key(size_t slot, const key_type& key) const noexcept { return pairs[slot].kmer == key; }
+    kmer_entry get(size_t slot) const noexcept { return kmer_entry::pack(pairs[slot]); }
+    void put(size_t slot, const kmer_entry& entry) noexcept { pairs[slot] = entry.unpack(); }
+};
+
+// Packed keys and extensions in separate arrays, so probes only stream
+// through keys and the extensions are read once, on a hit.
+struct SplitSlots {
+    typedef pkmer_t key_type;
+
+    aligned_vector<pkmer_t> keys;
+    aligned_vector<uint16_t> exts;
+
+    void resize(size_t n) {
+        keys.resize(n);
+        exts.resize(n);
+    }
+    size_t size() const noexcept { return keys.size(); }
+
+    static key_type make_key(const pkmer_t& kmer) noexcept { return kmer; }
+    bool has_key(size_t slot, const key_type& key) const noexcept { return keys[slot] == key; }
+    kmer_entry get(size_t slot) const noexcept {
+        kmer_pair kmer;
+        kmer.kmer = keys[slot];
+        memcpy(kmer.fb_ext, &exts[slot], 2);
+        return kmer_entry::pack(kmer);
+    }
+    void put(size_t slot, const kmer_entry& entry) noexcept {
+        kmer_pair kmer = entry.unpack();
+        keys[slot] = kmer.kmer;
+        memcpy(&exts[slot], kmer.fb_ext, 2);
+    }
+};
+
+// One kmer_entry per slot: 8 bytes for K <= 29, 16 for K <= 61, and a key
+// check is a single integer compare. That is a byte per slot more than
+// SplitSlots at K=19 and K=51, but inserts were faster (see README.md).
+struct EntrySlots {
+    typedef kmer_entry::key_type key_type;
+
+    aligned_vector<kmer_entry> entries;
+
+    void resize(size_t n) { entries.resize(n); }
+    size_t size() const noexcept { return entries.size(); }
+
+    static key_type make_key(const pkmer_t& kmer) noexcept { return kmer_entry::key(kmer); }
+    bool has_key(size_t slot, const key_type& key) const noexcept {
+        return entries[slot].has_key(key);
+    }
+    kmer_entry get(size_t slot) const noexcept { return entries[slot]; }
+    void put(size_t slot, const kmer_entry& entry) noexcept { entries[slot] = entry; }
+};
+
+// Open-addressing table for one rank's partition, in the style of Swiss
+// tables. Each slot has a control byte that is either EMPTY or the low 7
+// bits of the k-mer's hash, so a probe compares 16 control bytes at once
+// and only touches the k-mers whose fragment matches. Groups are visited
+// in triangular order (+1, +2, +3, ...), which keeps clusters short at high
+// load; the group count is a power of two, so the sequence reaches every
+// group before it repeats one. Probing stops after MAX_PROBE_GROUPS
+// groups; what does not fit goes to a small stash, so lookups cost at most
+// MAX_PROBE_GROUPS group scans plus the stash.
+//
+// Occupancy lives in the control bytes, so there is no separate used
+// array; Slots decides how the k-mers themselves are laid out. Records go
+// in and come out as kmer_entry, which is also what the RPCs carry.
+//
+// insert() is safe to call from several threads. find() may run
+// concurrently with other finds, but not with inserts.
+template <typename Slots> struct BasicLocalTable {
+    static constexpr signed char EMPTY = -128;
+
+    size_t n_groups;
+    aligned_vector<signed char> ctrl;
+    Slots slots;
+
+    std::vector<kmer_entry> stash;
+    size_t stash_used;
+
+    BasicLocalTable(size_t min_capacity);
+
+    size_t capacity() const noexcept;
+
+    bool insert(const kmer_entry& entry, uint64_t hash);
+    bool find(const pkmer_t& key_kmer, uint64_t hash, kmer_entry& val_entry) const;
+
+    bool insert(const kmer_pair& kmer, uint64_t hash);
+    bool find(const pkmer_t& key_kmer, uint64_t hash, kmer_pair& val_kmer) const;
+
+    // Call fn on every entry in groups [first, last), or in the stash
+    size_t groups() const noexcept;
+    template <typename F> void for_each(size_t first, size_t last, F fn) const;
+    template <typename F> void for_each_stashed(F fn) const;
+
+    // Bitmask of the slots in group whose control byte equals value
+    uint32_t match(size_t group, signed char value) const noexcept;
+
+    static signed char fragment(uint64_t hash) noexcept;
+    size_t first_group(uint64_t hash) const noexcept;
+};
+
+template <typename Slots> BasicLocalTable<Slots>::BasicLocalTable(size_t min_capacity) {
+    n_groups = 1;
+    while (n_groups * GROUP_WIDTH < min_capacity) {
+        n_groups *= 2;
+    }
+    ctrl.assign(n_groups * GROUP_WIDTH, EMPTY);
+    slots.resize(n_groups * GROUP_WIDTH);
+    stash.resize(STASH_SIZE);
+    stash_used = 0;
+}
+
+template <typename Slots> size_t BasicLocalTable<Slots>::capacity() const noexcept {
+    return slots.size();
+}
+
+template <typename Slots> size_t BasicLocalTable<Slots>::groups() const noexcept {
+    return n_groups;
+}
+
+template <typename Slots>
+template <typename F>
+void BasicLocalTable<Slots>::for_each(size_t first, size_t last, F fn) const {
+    for (size_t group = first; group < last; group++) {
+        uint32_t full = ~match(group, EMPTY) & ((1u << GROUP_WIDTH) - 1);
+        while (full != 0) {
+            fn(slots.get(group * GROUP_WIDTH + __builtin_ctz(full)));
+            full &= full - 1;
+        }
+    }
+}
+
+template <typename Slots>
+template <typename F>
+void BasicLocalTable<Slots>::for_each_stashed(F fn) const {
+    size_t stashed = stash_used < STASH_SIZE ? stash_used : STASH_SIZE;
+    for (size_t i = 0; i < stashed; i++) {
+        fn(stash[i]);
+    }
+}
+
+template <typename Slots>
+uint32_t BasicLocalTable<Slots>::match(size_t group, signed char value) const noexcept {
+    const signed char* group_ctrl = &ctrl[group * GROUP_WIDTH];
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128((const __m128i*)group_ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(group_ctrl[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+template <typename Slots> signed char BasicLocalTable<Slots>::fragment(uint64_t hash) noexcept {
+    return (signed char)(hash & 0x7F);
+}
+
+template <typename Slots>
+size_t BasicLocalTable<Slots>::first_group(uint64_t hash) const noexcept {
+    return (hash >> 7) & (n_groups - 1);
+}
+
+template <typename Slots>
+bool BasicLocalTable<Slots>::insert(const kmer_entry& entry, uint64_t hash) {
+    signed char h2 = fragment(hash);
+    size_t group = first_group(hash);
+
+    for (size_t probe = 0; probe < MAX_PROBE_GROUPS && probe < n_groups; probe++) {
+        uint32_t empty = match(group, EMPTY);
+
+        // Claiming a slot and publishing its fragment is one CAS, so
+        // concurrent inserters never share a slot
+        while (empty != 0) {
+            size_t slot = group * GROUP_WIDTH + __builtin_ctz(empty);
+            if (__sync_bool_compare_and_swap(&ctrl[slot], EMPTY, h2)) {
+                slots.put(slot, entry);
+                COUNT(counters().probes[log2_bucket(probe + 1, PROBE_BUCKETS)]++);
+                return true;
+            }
+            empty &= empty - 1;
+        }
+        group = (group + probe + 1) & (n_groups - 1);
+    }
+
+    size_t stashed = __sync_fetch_and_add(&stash_used, 1);
+    if (stashed >= STASH_SIZE) {
+        return false;
+    }
+    stash[stashed] = entry;
+    COUNT(counters().probes[PROBE_BUCKETS - 1]++);
+    return true;
+}
+
+template <typename Slots>
+bool BasicLocalTable<Slots>::find(const pkmer_t& key_kmer, uint64_t hash,
+                                  kmer_entry& val_entry) const {
+    typename Slots::key_type key = Slots::make_key(key_kmer);
+    signed char h2 = fragment(hash);
+    size_t group = first_group(hash);
+
+    for (size_t probe = 0; probe < MAX_PROBE_GROUPS && probe < n_groups; probe++) {
+        uint32_t candidates = match(group, h2);
+        while (candidates != 0) {
+            size_t slot = group * GROUP_WIDTH + __builtin_ctz(candidates);
+            if (slots.has_key(slot, key)) {
+                val_entry = slots.get(slot);
+                return true;
+            }
+            candidates &= candidates - 1;
+        }
+
+        // Inserts fill a group before moving on, so a gap ends the search
+        if (match(group, EMPTY) != 0) {
+            return false;
+        }
+        group = (group + probe + 1) & (n_groups - 1);
+    }
+
+    kmer_entry::key_type stash_key = kmer_entry::key(key_kmer);
+    size_t stashed = stash_used < STASH_SIZE ? stash_used : STASH_SIZE;
+    for (size_t i = 0; i < stashed; i++) {
+        if (stash[i].has_key(stash_key)) {
+            val_entry = stash[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Slots> bool BasicLocalTable<Slots>::insert(const kmer_pair& kmer, uint64_t hash) {
+    return insert(kmer_entry::pack(kmer), hash);
+}
+
+template <typename Slots>
+bool BasicLocalTable<Slots>::find(const pkmer_t& key_kmer, uint64_t hash,
+                                  kmer_pair& val_kmer) const {
+    kmer_entry entry;
+    if (!find(key_kmer, hash, entry)) {
+        return false;
+    }
+    val_kmer = entry.unpack();
+    return true;
+}
+
+#if TABLE_LAYOUT == TABLE_LAYOUT_PAIRS
+typedef BasicLocalTable<PairSlots> LocalTable;
+#elif TABLE_LAYOUT == TABLE_LAYOUT_SPLIT
+typedef BasicLocalTable<SplitSlots> LocalTable;
+#else
+typedef BasicLocalTable<EntrySlots> LocalTable;
+#endif
+
+// Pause between polls of a contended flag, so a spinning thread does not
+// starve its sibling hyperthread or flood the line with reads
+inline void cpu_relax() noexcept {
+#if defined(__SSE2__)
+    _mm_pause();
+#endif
+}
+
+// Reader/writer spinlock. Any number of threads hold it shared; one holds
+// it exclusively once the shared holders have left. A waiting writer keeps
+// new readers out, so a stream of readers cannot hold it off. Waiters poll
+// with plain loads and cpu_relax().
+class ResizeLock {
+    static constexpr int WRITER = 1 << 30;
+    std::atomic<int> state{0};
+
+  public:
+    void lock_shared() noexcept {
+        while (state.fetch_add(1, std::memory_order_acquire) & WRITER) {
+            state.fetch_sub(1, std::memory_order_relaxed);
+            while (state.load(std::memory_order_relaxed) & WRITER) {
+                cpu_relax();
+            }
+        }
+    }
+    void unlock_shared() noexcept { state.fetch_sub(1, std::memory_order_release); }
+
+    void lock() noexcept {
+        int seen = state.load(std::memory_order_relaxed);
+        while ((seen & WRITER) != 0 ||
+               !state.compare_exchange_weak(seen, seen | WRITER, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+            cpu_relax();
+            seen = state.load(std::memory_order_relaxed);
+        }
+        while (state.load(std::memory_order_acquire) != WRITER) {
+            cpu_relax();
+        }
+    }
+    void unlock() noexcept { state.fetch_sub(WRITER, std::memory_order_release); }
+};
+
+// One rank's partition, grown while it is being filled. Once it holds more
+// than MAX_LOAD_FACTOR entries per slot (or a k-mer does not fit) it
+// switches to a LocalTable twice the size. The old table is kept, and every
+// later insert moves MIGRATE_GROUPS of its groups over, so no single insert
+// pays for the whole copy. Lookups try the new table, then the old one.
+//
+// Threads and RPCs share a partition. Inserts hold resize_lock shared and
+// claim slots with LocalTable's CAS, so they do not wait for each other,
+// and they claim the groups they move with an atomic counter. Only grow()
+// and retiring the old table hold the lock exclusively, once per doubling,
+// and every inserter waits for them. Against the fixed-size table, each
+// insert pays three atomic adds on counters all threads share: taking and
+// dropping the lock, and counting the entry.
+//
+// find() may run concurrently with other finds, but not with inserts.
+// Hash is the policy the callers hash with, since moving entries rehashes.
+template <typename Hash> struct BasicGrowableTable {
+    std::unique_ptr<LocalTable> table;
+    std::unique_ptr<LocalTable> old_table;
+
+    // First group of old_table no insert has claimed to move yet
+    std::atomic<size_t> next_group;
+
+    std::atomic<size_t> n_entries;
+    int n_grows;
+    ResizeLock resize_lock;
+
+    // Rehashes what it moves; must match the hash inserts and finds pass
+    Hash hasher;
+
+    BasicGrowableTable(size_t min_capacity, const Hash& hasher = make_kmer_hash<Hash>());
+
+    size_t size() const noexcept;
+    size_t capacity() const noexcept;
+
+    bool insert(const kmer_entry& entry, uint64_t hash);
+    bool find(const pkmer_t& key_kmer, uint64_t hash, kmer_entry& val_entry) const;
+
+    bool insert(const kmer_pair& kmer, uint64_t hash);
+    bool find(const pkmer_t& key_kmer, uint64_t hash, kmer_pair& val_kmer) const;
+
+    // With resize_lock shared: claim and move up to n_groups groups, and
+    // return whether any are left unclaimed
+    bool migrate(size_t n_groups);
+    // With resize_lock exclusive: move what is left of the old table and
+    // drop it, then start over in a table twice the size
+    void finish_migration();
+    void grow();
+
+    // Insert an entry of the old table into the new one
+    void move_entry(const kmer_entry& entry);
+};
+
+template <typename Hash>
+BasicGrowableTable<Hash>::BasicGrowableTable(size_t min_capacity, const Hash& hasher)
+    : table(new LocalTable(min_capacity)), next_group(0), n_entries(0), n_grows(0),
+      hasher(hasher) {}
+
+template <typename Hash> size_t BasicGrowableTable<Hash>::size() const noexcept {
+    return n_entries.load(std::memory_order_relaxed);
+}
+
+template <typename Hash> size_t BasicGrowableTable<Hash>::capacity() const noexcept {
+    return table->capacity();
+}
+
+template <typename Hash>
+bool BasicGrowableTable<Hash>::insert(const kmer_entry& entry, uint64_t hash) {
+    bool grew = false;
+    while (true) {
+        int grows;
+        bool full;
+        {
+            std::shared_lock<ResizeLock> shared(resize_lock);
+            grows = n_grows;
+            if (old_table && !migrate(MIGRATE_GROUPS)) {
+                // Every group is claimed; retire the old table first
+                full = false;
+            } else {
+                full = size() + 1 > MAX_LOAD_FACTOR * table->capacity() ||
+                       !table->insert(entry, hash);
+                if (!full) {
+                    n_entries.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+
+        std::lock_guard<ResizeLock> exclusive(resize_lock);
+        // Another thread may have grown the table while this one waited
+        if (n_grows != grows) {
+            continue;
+        }
+        if (!full) {
+            finish_migration();
+        } else if (grew) {
+            // It did not fit in a table this insert grew itself
+            return false;
+        } else {
+            grow();
+            grew = true;
+        }
+    }
+}
+
+template <typename Hash>
+bool BasicGrowableTable<Hash>::find(const pkmer_t& key_kmer, uint64_t hash,
+                                    kmer_entry& val_entry) const {
+    if (table->find(key_kmer, hash, val_entry)) {
+        return true;
+    }
+    return old_table && old_table->find(key_kmer, hash, val_entry);
+}
+
+template <typename Hash>
+bool BasicGrowableTable<Hash>::insert(const kmer_pair& kmer, uint64_t hash) {
+    return insert(kmer_entry::pack(kmer), hash);
+}
+
+template <typename Hash>
+bool BasicGrowableTable<Hash>::find(const pkmer_t& key_kmer, uint64_t hash,
+                                    kmer_pair& val_kmer) const {
+    kmer_entry entry;
+    if (!find(key_kmer, hash, entry)) {
+        return false;
+    }
+    val_kmer = entry.unpack();
+    return true;
+}
+
+template <typename Hash> void BasicGrowableTable<Hash>::grow() {
+    finish_migration();
+    old_table = std::move(table);
+    table.reset(new LocalTable(2 * old_table->capacity()));
+    next_group.store(0, std::memory_order_relaxed);
+    n_grows++;
+}
+
+template <typename Hash> bool BasicGrowableTable<Hash>::migrate(size_t n_groups) {
+    size_t first = next_group.fetch_add(n_groups, std::memory_order_relaxed);
+    size_t last = std::min(first + n_groups, old_table->groups());
+    if (first < last) {
+        old_table->for_each(first, last, [this](const kmer_entry& entry) { move_entry(entry); });
+    }
+    return last < old_table->groups();
+}
+
+template <typename Hash> void BasicGrowableTable<Hash>::finish_migration() {
+    if (!old_table) {
+        return;
+    }
+    auto move = [this](const kmer_entry& entry) { move_entry(entry); };
+    size_t first = std::min(next_group.load(std::memory_order_relaxed), old_table->groups());
+    old_table->for_each(first, old_table->groups(), move);
+    old_table->for_each_stashed(move);
+    old_table.reset();
+}
+
+template <typename Hash> void BasicGrowableTable<Hash>::move_entry(const kmer_entry& entry) {
+    // The new table is at most half full, so this only fails if its stash
+    // overflows
+    if (!table->insert(entry, entry.kmer().hash(hasher))) {
+        throw std::runtime_error("Error: HashMap is full!");
+    }
+}
+
+typedef BasicGrowableTable<DefaultKmerHash> GrowableTable;
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "counters.hpp"
+#include "kmer_entry.hpp"
+#include "kmer_t.hpp"
+#include "rpc_transport.hpp"
+#include "trace.hpp"
+
+// K-mers per mailbox, and mailboxes each rank may fill at each owner
+#define MAILBOX_SIZE 256
+#define MAILBOXES 4
+
+// Ships k-mers with rput into mailboxes in the owner's shared segment
+// instead of serializing them into RPCs. Every rank keeps MAILBOXES boxes
+// for every sender; a full buffer is put into a free box, the owner
+// unloads it into its partition once the data has landed and acks the
+// box back, so each sender has at most MAILBOXES batches on the wire per
+// owner. The inbox takes rank_n() * MAILBOXES * MAILBOX_SIZE entries of
+// the shared segment. Finds are the RPC transport's.
+template <typename Map> struct MailboxTransport : RpcTransport<Map> {
+    // K-mers one inserting thread has not sent yet, and its boxes that
+    // have not been acked. Acks run on the master persona, hence atomics.
+    struct SendBuffers {
+        std::vector<std::vector<wire_entry>> buff;
+        std::atomic<int> in_flight;
+        std::atomic<bool> failed;
+
+        SendBuffers();
+    };
+
+    // This rank's inbox, and every rank's
+    upcxx::global_ptr<wire_entry> inbox;
+    upcxx::dist_object<upcxx::global_ptr<wire_entry>> inbox_g;
+    std::vector<upcxx::global_ptr<wire_entry>> inboxes;
+
+    // Boxes this rank may fill at each owner; the threads share them
+    std::mutex lock;
+    std::vector<std::vector<int>> free_boxes;
+
+    MailboxTransport(Map& map1);
+    ~MailboxTransport();
+
+    bool insert(const kmer_pair& kmer, uint64_t hash, int owner, SendBuffers& buffers);
+    bool flush(SendBuffers& buffers);
+
+    // Put the buffer for owner into one of its boxes
+    void send_box(int owner, SendBuffers& buffers);
+
+    // A free box at owner, waiting for an ack if there is none
+    int take_box(int owner);
+    void release_box(int owner, int box);
+
+    // Where sender's box is in this rank's inbox
+    wire_entry* box_entries(int sender, int box) const;
+};
+
+template <typename Map> MailboxTransport<Map>::SendBuffers::SendBuffers() {
+    buff.resize(upcxx::rank_n());
+    for (auto& buf : buff) {
+        buf.reserve(MAILBOX_SIZE);
+    }
+    in_flight = 0;
+    failed = false;
+}
+
+template <typename Map>
+MailboxTransport<Map>::MailboxTransport(Map& map1)
+    : RpcTransport<Map>(map1),
+      inbox(upcxx::new_array<wire_entry>(size_t(upcxx::rank_n()) * MAILBOXES * MAILBOX_SIZE)),
+      inbox_g(inbox) {
+    inboxes.resize(upcxx::rank_n());
+    for (int i = 0; i < upcxx::rank_n(); i++) {
+        inboxes[i] = inbox_g.fetch(i).wait();
+    }
+
+    free_boxes.resize(upcxx::rank_n());
+    for (auto& boxes : free_boxes) {
+        for (int box = 0; box < MAILBOXES; box++) {
+            boxes.push_back(box);
+        }
+    }
+}
+
+template <typename Map> MailboxTransport<Map>::~MailboxTransport() {
+    upcxx::delete_array(inbox);
+}
+
+template <typename Map>
+bool MailboxTransport<Map>::insert(const kmer_pair& kmer, uint64_t hash, int owner,
+                                   SendBuffers& buffers) {
+    // Our own k-mers skip the mailboxes entirely
+    if (owner == upcxx::rank_me()) {
+        return this->map.local.insert(kmer, hash);
+    }
+
+    buffers.buff[owner].push_back(wire_entry::pack(kmer_entry::pack(kmer)));
+    if (buffers.buff[owner].size() == MAILBOX_SIZE) {
+        send_box(owner, buffers);
+
+        // Let boxes sent to us be unloaded while we keep producing
+        upcxx::progress();
+    }
+    return true;
+}
+
+template <typename Map> bool MailboxTransport<Map>::flush(SendBuffers& buffers) {
+    for (int owner = 0; owner < upcxx::rank_n(); owner++) {
+        if (!buffers.buff[owner].empty()) {
+            send_box(owner, buffers);
+        }
+    }
+
+    // Wait until every owner has unloaded what we sent it
+    TRACE_SPAN("drain mailboxes");
+    while (buffers.in_flight.load() > 0) {
+        upcxx::progress();
+    }
+    return !buffers.failed.load();
+}
+
+template <typename Map> void MailboxTransport<Map>::send_box(int owner, SendBuffers& buffers) {
+    std::vector<wire_entry>& buf = buffers.buff[owner];
+    int box = take_box(owner);
+
+    TRACE_INSTANT("send mailbox", buf.size());
+    COUNT(counters().buffer_flushes++;
+          counters().count_rpc(owner, buf.size() * sizeof(wire_entry)));
+    buffers.in_flight++;
+
+    // The source completes before rput returns, so the buffer can be
+    // reused; the owner is told once the k-mers are in its inbox
+    upcxx::global_ptr<wire_entry> dst =
+        inboxes[owner] + (size_t(upcxx::rank_me()) * MAILBOXES + box) * MAILBOX_SIZE;
+    upcxx::rput(
+        buf.data(), dst, buf.size(),
+        upcxx::source_cx::as_blocking() |
+            upcxx::remote_cx::as_rpc(
+                [](upcxx::dist_object<Map*>& dst_map, int sender, int box, size_t n,
+                   uintptr_t sender_buffers) {
+                    TRACE_SPAN_ARG("unload mailbox", n);
+                    Map& owner_map = **dst_map;
+
+                    bool inserted = true;
+                    const wire_entry* entries = owner_map.transport.box_entries(sender, box);
+                    for (size_t i = 0; i < n && inserted; i++) {
+                        kmer_entry entry = entries[i].unpack();
+                        inserted = owner_map.local.insert(entry, owner_map.hash(entry.kmer()));
+                    }
+
+                    // The box can be filled again once its k-mers are in the table
+                    upcxx::rpc_ff(
+                        sender,
+                        [](upcxx::dist_object<Map*>& src_map, int owner, int box,
+                           uintptr_t sender_buffers, bool inserted) {
+                            (*src_map)->transport.release_box(owner, box);
+                            SendBuffers& buffers = *(SendBuffers*)sender_buffers;
+                            if (!inserted) {
+                                buffers.failed = true;
+                            }
+                            buffers.in_flight--;
+                        },
+                        dst_map, upcxx::rank_me(), box, sender_buffers, inserted);
+                },
+                this->map.self, upcxx::rank_me(), box, buf.size(), uintptr_t(&buffers)));
+    buf.clear();
+}
+
+template <typename Map> int MailboxTransport<Map>::take_box(int owner) {
+    std::unique_lock<std::mutex> guard(lock);
+    if (free_boxes[owner].empty()) {
+        TRACE_SPAN("wait for mailbox");
+        do {
+            guard.unlock();
+            upcxx::progress();
+            guard.lock();
+        } while (free_boxes[owner].empty());
+    }
+    int box = free_boxes[owner].back();
+    free_boxes[owner].pop_back();
+    return box;
+}
+
+template <typename Map> void MailboxTransport<Map>::release_box(int owner, int box) {
+    std::lock_guard<std::mutex> guard(lock);
+    free_boxes[owner].push_back(box);
+}
+
+template <typename Map>
+wire_entry* MailboxTransport<Map>::box_entries(int sender, int box) const {
+    return inbox.local() + (size_t(sender) * MAILBOXES + box) * MAILBOX_SIZE;
+}
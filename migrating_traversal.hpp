@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "contig.hpp"
+#include "contig_writer.hpp"
+#include "counters.hpp"
+#include "kmer_t.hpp"
+#include "trace.hpp"
+#include "traversal.hpp"
+#include "work_queue.hpp"
+
+// Bases a walk carries before it sends them home, in bytes of four
+#define WALK_SEGMENT_BYTES 256
+
+// Owner-migrating traversal: instead of fetching each k-mer to the rank
+// walking the contig, the walk moves to the k-mers. A rank advances a walk
+// through every k-mer it owns, then hands the walk to the owner of the next
+// one with a single one-way RPC, so a remote step costs one message rather
+// than a round trip and nobody waits on a lookup. The rank the walk started
+// on receives the bases, in segments for long contigs, and the end.
+//
+// Needs a Map with hash(key), owner(key, hash) and find_local(key, hash,
+// kmer_pair&).
+
+// A walk in flight: its last k-mer and the bases it added since the last
+// segment went home. contig and state are the origin's Contig and
+// MigrationState, opaque on every other rank.
+struct Walk {
+    int origin;
+    uint64_t contig;
+    uint64_t state;
+    kmer_pair last;
+
+    // Bases since the start node, and where packed begins among them
+    uint64_t n_bases;
+    uint64_t first_byte;
+    std::vector<unsigned char> packed;
+
+    bool failed;
+
+    void push_back(const kmer_pair& kmer);
+
+    UPCXX_SERIALIZED_FIELDS(origin, contig, state, last, n_bases, first_byte, packed, failed)
+};
+
+void Walk::push_back(const kmer_pair& kmer) {
+    pack_base(packed, n_bases, last.forwardExt());
+    n_bases++;
+    last = kmer;
+}
+
+// A contig whose bases are still arriving
+struct PendingContig {
+    uint64_t received = 0;
+    // Known once the walk has ended
+    uint64_t total = UINT64_MAX;
+};
+
+// Bookkeeping of the walks started by one thread
+struct MigrationState {
+    std::atomic<int> in_flight{0};
+    std::atomic<bool> failed{false};
+    ContigWriter* output = nullptr;
+
+    // Guards the contigs' bases, which live in the thread's arena, and pending
+    std::mutex lock;
+    std::unordered_map<Contig*, PendingContig> pending;
+
+    // Copy a segment of a walk's bases into its contig, and finish the
+    // contig if it was the last one outstanding
+    void receive(Contig& contig, uint64_t first_byte, const std::vector<unsigned char>& bytes,
+                 const Walk* end);
+};
+
+void MigrationState::receive(Contig& contig, uint64_t first_byte,
+                             const std::vector<unsigned char>& bytes, const Walk* end) {
+    bool done;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (contig.packed.size() < first_byte + bytes.size()) {
+            contig.packed.resize(first_byte + bytes.size(), 0);
+        }
+        if (!bytes.empty()) {
+            memcpy(&contig.packed[first_byte], bytes.data(), bytes.size());
+        }
+
+        PendingContig& record = pending[&contig];
+        record.received += bytes.size();
+        if (end != nullptr) {
+            contig.last = end->last;
+            contig.n_bases = end->n_bases;
+            record.total = (end->n_bases + 3) / 4;
+        }
+        done = record.received == record.total;
+        if (done) {
+            pending.erase(&contig);
+        }
+    }
+
+    if (done) {
+        if (output != nullptr) {
+            output->add(contig);
+            output->pump();
+        }
+        in_flight--;
+    }
+}
+
+// On the origin: a segment of bases, or the end of the walk
+void walk_arrived(Walk& walk, bool end) {
+    MigrationState& state = *reinterpret_cast<MigrationState*>(walk.state);
+    Contig& contig = *reinterpret_cast<Contig*>(walk.contig);
+    if (end && walk.failed) {
+        state.failed = true;
+        state.in_flight--;
+        return;
+    }
+    state.receive(contig, walk.first_byte, walk.packed, end ? &walk : nullptr);
+}
+
+// Send walk's bases, or its end, to its origin
+void send_home(Walk& walk, bool end) {
+    if (walk.origin == upcxx::rank_me()) {
+        walk_arrived(walk, end);
+        return;
+    }
+    COUNT(counters().count_rpc(walk.origin, sizeof(Walk) + walk.packed.size()));
+    upcxx::rpc_ff(walk.origin, [](Walk walk, bool end) { walk_arrived(walk, end); }, walk, end);
+}
+
+// Advance walk through the k-mers this rank owns, then forward it to the
+// owner of the next one, or send it home at the end of the contig. hopped
+// is set when the walk has just been forwarded here.
+template <typename Map>
+void continue_walk(upcxx::dist_object<Map*>& map_g, Walk& walk, bool hopped) {
+    Map& hashmap = **map_g;
+    while (walk.last.forwardExt() != 'F') {
+        pkmer_t next = walk.last.next_kmer();
+        uint64_t hash = hashmap.hash(next);
+        int owner = hashmap.owner(next, hash);
+        if (owner != upcxx::rank_me()) {
+            COUNT(counters().walk_hops++;
+                  counters().count_rpc(owner, sizeof(Walk) + walk.packed.size()));
+            upcxx::rpc_ff(
+                owner,
+                [](upcxx::dist_object<Map*>& map_g, Walk walk) {
+                    TRACE_SPAN("walk handler");
+                    continue_walk(map_g, walk, true);
+                },
+                map_g, walk);
+            return;
+        }
+
+        kmer_pair kmer;
+        if (!hashmap.find_local(next, hash, kmer)) {
+            walk.failed = true;
+            break;
+        }
+        walk.push_back(kmer);
+        COUNT(counters().walk_steps++; counters().local_steps += !hopped);
+        hopped = false;
+
+        // Keep what travels small; segments end on a whole byte
+        if (walk.packed.size() >= WALK_SEGMENT_BYTES && walk.n_bases % 4 == 0) {
+            send_home(walk, false);
+            walk.first_byte += walk.packed.size();
+            walk.packed.clear();
+        }
+    }
+    send_home(walk, true);
+}
+
+// Like traverse_async, but each walk runs on the owners of its k-mers.
+// Every rank serves the walks of others while it waits for its own, so
+// the caller must keep making progress (a barrier does) until all ranks
+// are done.
+template <typename Map>
+ContigSet traverse_migrating(upcxx::dist_object<Map*>& map_g, WorkQueue& queue,
+                             ContigWriter* output = nullptr) {
+    ContigSet contigs;
+    MigrationState state;
+    state.output = output;
+
+    std::vector<kmer_pair> batch;
+    while (queue.take(batch, TAKE_BATCH)) {
+        for (const auto& start_kmer : batch) {
+            Contig& contig = contigs.add(start_kmer);
+            COUNT(counters().walks++);
+
+            Walk walk;
+            walk.origin = upcxx::rank_me();
+            walk.contig = reinterpret_cast<uint64_t>(&contig);
+            walk.state = reinterpret_cast<uint64_t>(&state);
+            walk.last = start_kmer;
+            walk.n_bases = 0;
+            walk.first_byte = 0;
+            walk.failed = false;
+
+            state.in_flight++;
+            continue_walk(map_g, walk, false);
+
+            if (state.in_flight >= MAX_WALKS_IN_FLIGHT) {
+                TRACE_SPAN("wait for walks");
+                while (state.in_flight >= MAX_WALKS_IN_FLIGHT) {
+                    upcxx::progress();
+                }
+            }
+        }
+    }
+
+    TRACE_SPAN("drain walks");
+    while (state.in_flight > 0) {
+        upcxx::progress();
+    }
+    if (output != nullptr) {
+        output->wait_claims();
+    }
+
+    if (state.failed) {
+        throw std::runtime_error("Error: k-mer not found in hashmap.");
+    }
+    return contigs;
+}
@@ -1,6 +1,13 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #ifndef KMER_LEN
 #define KMER_LEN 19
@@ -8,100 +15,326 @@
 
 #define PACKED_KMER_LEN ((KMER_LEN + 3) / 4)
 
-bool packedCodeToFourMerCoded = false;
-unsigned int packedCodeToFourMer[256];
-
-#define pow4(a) (1 << ((a) << 1))
-
-void init_LookupTable() {
-    // Work with 4-mers for the moment to have small lookup tables
-    int merLen = 4, i, slot, valInSlot;
-    unsigned char mer[4];
-
-    for (i = 0; i < 256; i++) {
-        // convert a packedcode to a 4-mer
-        int remainder = i;
-        int pos = 0;
-        for (slot = merLen - 1; slot >= 0; slot--) {
-            valInSlot = remainder / pow4(slot);
-            char base;
-
-            if (valInSlot == 0) {
-                base = 'A';
-            } else if (valInSlot == 1) {
-                base = 'C';
-            } else if (valInSlot == 2) {
-                base = 'G';
-            } else if (valInSlot == 3) {
-                base = 'T';
-            } else {
-                assert(0);
-            }
-
-            mer[pos] = base;
-            pos++;
-            remainder -= valInSlot * pow4(slot);
+// Bases are packed four to a byte, first base in the two high bits,
+// with A=0, C=1, G=2, T=3. Trailing bases of the last byte are 'A'.
+
+// Lookup tables, built at compile time.
+struct BaseCodeTable {
+    unsigned char code[256];
+};
+
+struct FourMerTable {
+    // Four ASCII bases per packed byte, first base in the low byte
+    uint32_t chars[256];
+};
+
+constexpr BaseCodeTable make_BaseCodeTable() {
+    BaseCodeTable table{};
+    table.code['C'] = table.code['c'] = 1;
+    table.code['G'] = table.code['g'] = 2;
+    table.code['T'] = table.code['t'] = 3;
+    return table;
+}
+
+constexpr FourMerTable make_FourMerTable() {
+    FourMerTable table{};
+    const char bases[4] = {'A', 'C', 'G', 'T'};
+    for (int i = 0; i < 256; i++) {
+        uint32_t chars = 0;
+        for (int pos = 0; pos < 4; pos++) {
+            uint32_t base = (unsigned char)bases[(i >> (6 - 2 * pos)) & 3];
+            chars |= base << (8 * pos);
         }
-        unsigned int* merAsUInt = (unsigned int*)mer;
-        packedCodeToFourMer[i] = (unsigned int)(*merAsUInt);
+        table.chars[i] = chars;
     }
+    return table;
 }
 
+constexpr BaseCodeTable baseToCode = make_BaseCodeTable();
+constexpr FourMerTable packedCodeToFourMer = make_FourMerTable();
+
 unsigned char packFourMer(const char* fourMer) {
-    int retval = 0;
-    int code, i;
-    int pow = 64;
-
-    for (i = 0; i < 4; i++) {
-        char base = fourMer[i];
-        switch (base) {
-        case 'A':
-            code = 0;
-            break;
-        case 'C':
-            code = 1;
-            break;
-        case 'G':
-            code = 2;
-            break;
-        case 'T':
-            code = 3;
-            break;
+    const unsigned char* mer = (const unsigned char*)fourMer;
+    return (baseToCode.code[mer[0]] << 6) | (baseToCode.code[mer[1]] << 4) |
+           (baseToCode.code[mer[2]] << 2) | baseToCode.code[mer[3]];
+}
+
+// Scalar kernels: the fallback without SSSE3, and bench_packing's baseline.
+
+// Pack bases [first, KMER_LEN) into packed_kmer, first must be a multiple of 4.
+void packKmerTail(const char* kmer, unsigned char* packed_kmer, int first) {
+    int i = first / 4, j = first;
+
+    for (; j <= KMER_LEN - 4; i++, j += 4) {
+        packed_kmer[i] = packFourMer(kmer + j);
+    }
+
+    // Pad the last byte with 'A' (code 0)
+    if (j < KMER_LEN) {
+        unsigned char last = 0;
+        for (int ind = 0; j + ind < KMER_LEN; ind++) {
+            last |= baseToCode.code[(unsigned char)kmer[j + ind]] << (6 - 2 * ind);
         }
-        retval += code * pow;
-        pow /= 4;
+        packed_kmer[i] = last;
     }
-    return ((unsigned char)retval);
 }
 
-void packKmer(const char* kmer, unsigned char* packed_kmer) {
-    int ind, j = 0;
-    int i = 0;
+// Unpack bases [first, KMER_LEN) into kmer, first must be a multiple of 4.
+void unpackKmerTail(const unsigned char* packed_kmer, char* kmer, int first) {
+    int i = first / 4, j = first;
 
     for (; j <= KMER_LEN - 4; i++, j += 4) {
-        packed_kmer[i] = packFourMer(kmer + j);
+        memcpy(kmer + j, &packedCodeToFourMer.chars[packed_kmer[i]], 4);
     }
 
-    int remainder = KMER_LEN % 4;
-    char blockSeq[5] = "AAAA";
-    for (ind = 0; ind < remainder; ind++) {
-        blockSeq[ind] = kmer[j + ind];
+    if (j < KMER_LEN) {
+        char block[4];
+        memcpy(block, &packedCodeToFourMer.chars[packed_kmer[i]], 4);
+        memcpy(kmer + j, block, KMER_LEN - j);
+    }
+}
+
+void packKmerScalar(const char* kmer, unsigned char* packed_kmer) {
+    packKmerTail(kmer, packed_kmer, 0);
+}
+
+void unpackKmerScalar(const unsigned char packed_kmer[PACKED_KMER_LEN], char* kmer) {
+    unpackKmerTail(packed_kmer, kmer, 0);
+}
+
+// Vector kernels. pack16/pack32 turn 16 (SSSE3) or 32 (AVX2) ASCII bases
+// into 4 or 8 packed bytes, unpack16 turns 4 packed bytes into 16 bases.
+// They are built on every x86-64 target, each with its instruction set
+// enabled for that function alone, and packing_kernels picks the widest
+// set the CPU runs when the program starts, so no -march flag is needed.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PACKING_VECTOR 1
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PACKING_VECTOR 0
+#endif
+
+// Kernel sets, narrowest first
+#define PACKING_SCALAR 0
+#define PACKING_SSSE3 1
+#define PACKING_AVX2 2
+
+const char* const packing_kernel_names[] = {"scalar", "SSSE3", "AVX2"};
+
+int detect_packing_kernels() {
+#if PACKING_VECTOR
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return PACKING_AVX2;
     }
+    if (__builtin_cpu_supports("ssse3")) {
+        return PACKING_SSSE3;
+    }
+#endif
+    return PACKING_SCALAR;
+}
+
+const int packing_kernels = detect_packing_kernels();
+
+#if PACKING_VECTOR
+TARGET_SSSE3 inline void pack16(const char* in, unsigned char* out) {
+    // The low nibble tells the bases apart: A=1, C=3, G=7, T=4
+    const __m128i codes = _mm_setr_epi8(0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i c = _mm_shuffle_epi8(codes, _mm_loadu_si128((const __m128i*)in));
+
+    // c0*64 + c1*16 + c2*4 + c3 in each 32-bit lane, then gather the low bytes
+    __m128i pairs = _mm_maddubs_epi16(c, _mm_set1_epi32(0x01041040));
+    __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi16(1));
+    __m128i bytes = _mm_shuffle_epi8(
+        quads, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
 
-    packed_kmer[i] = packFourMer(blockSeq);
+    uint32_t packed = _mm_cvtsi128_si32(bytes);
+    memcpy(out, &packed, 4);
 }
 
+// Spread packed bytes (one per group of four lanes) into ASCII bases
+TARGET_SSSE3 inline __m128i unpack_lanes(__m128i rep) {
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    const __m128i first_pair = _mm_setr_epi8(-1, -1, 0, 0, -1, -1, 0, 0, -1, -1, 0, 0, -1, -1, 0, 0);
+    const __m128i even_pos = _mm_setr_epi8(-1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0);
+    const __m128i high_base = _mm_setr_epi8('A', 'A', 'A', 'A', 'C', 'C', 'C', 'C', 'G', 'G', 'G',
+                                            'G', 'T', 'T', 'T', 'T');
+    const __m128i low_base = _mm_setr_epi8('A', 'C', 'G', 'T', 'A', 'C', 'G', 'T', 'A', 'C', 'G',
+                                           'T', 'A', 'C', 'G', 'T');
+
+    // Bases 0,1 of a byte live in its high nibble, bases 2,3 in its low nibble
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(rep, 4), low_nibble);
+    __m128i lo = _mm_and_si128(rep, low_nibble);
+    __m128i nib = _mm_or_si128(_mm_and_si128(first_pair, hi), _mm_andnot_si128(first_pair, lo));
+
+    __m128i even = _mm_shuffle_epi8(high_base, nib);
+    __m128i odd = _mm_shuffle_epi8(low_base, nib);
+    return _mm_or_si128(_mm_and_si128(even_pos, even), _mm_andnot_si128(even_pos, odd));
+}
+
+TARGET_SSSE3 inline void unpack16(const unsigned char* in, char* out) {
+    uint32_t packed;
+    memcpy(&packed, in, 4);
+    __m128i rep = _mm_shuffle_epi8(_mm_cvtsi32_si128(packed),
+                                   _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3));
+    _mm_storeu_si128((__m128i*)out, unpack_lanes(rep));
+}
+
+TARGET_AVX2 inline void pack32(const char* in, unsigned char* out) {
+    const __m256i codes = _mm256_setr_epi8(0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                           0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m256i c = _mm256_shuffle_epi8(codes, _mm256_loadu_si256((const __m256i*)in));
+
+    __m256i pairs = _mm256_maddubs_epi16(c, _mm256_set1_epi32(0x01041040));
+    __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi16(1));
+    __m256i bytes = _mm256_shuffle_epi8(
+        quads, _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4,
+                                8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1));
+
+    uint64_t packed = _mm_cvtsi128_si64(_mm256_castsi256_si128(bytes));
+    memcpy(out, &packed, 8);
+}
+
+// The last KMER_LEN % 16 bases go through the vector kernels as well,
+// without touching anything past the k-mer. pack16Last packs the 16 bases
+// that end the k-mer and shifts out the ones already packed (k-mers
+// shorter than that are packed by the scalar kernel); unpack16Tail
+// unpacks into a buffer and copies out the bases that are wanted.
+TARGET_SSSE3 inline void pack16Last(const char* kmer, unsigned char* packed_kmer) {
+    const int first = KMER_LEN / 16 * 16;
+    uint32_t packed;
+    pack16(kmer + KMER_LEN - 16, (unsigned char*)&packed);
+    packed = __builtin_bswap32(uint32_t(uint64_t(__builtin_bswap32(packed))
+                                        << (2 * (16 - (KMER_LEN - first)))));
+    memcpy(packed_kmer + first / 4, &packed, (KMER_LEN - first + 3) / 4);
+}
+
+TARGET_SSSE3 inline void unpack16Tail(const unsigned char* in, char* out, int n_bases) {
+    unsigned char packed[4] = {0, 0, 0, 0};
+    memcpy(packed, in, (n_bases + 3) / 4);
+    char bases[16];
+    unpack16(packed, bases);
+    memcpy(out, bases, n_bases);
+}
+
+TARGET_SSSE3 inline void packKmerSSSE3(const char* kmer, unsigned char* packed_kmer) {
+    int j = 0;
+    for (; j + 16 <= KMER_LEN; j += 16) {
+        pack16(kmer + j, packed_kmer + j / 4);
+    }
+    if (j < KMER_LEN && KMER_LEN >= 16) {
+        pack16Last(kmer, packed_kmer);
+    } else if (j < KMER_LEN) {
+        packKmerTail(kmer, packed_kmer, j);
+    }
+}
+
+TARGET_AVX2 inline void packKmerAVX2(const char* kmer, unsigned char* packed_kmer) {
+    int j = 0;
+    for (; j + 32 <= KMER_LEN; j += 32) {
+        pack32(kmer + j, packed_kmer + j / 4);
+    }
+    for (; j + 16 <= KMER_LEN; j += 16) {
+        pack16(kmer + j, packed_kmer + j / 4);
+    }
+    if (j < KMER_LEN && KMER_LEN >= 16) {
+        pack16Last(kmer, packed_kmer);
+    } else if (j < KMER_LEN) {
+        packKmerTail(kmer, packed_kmer, j);
+    }
+}
+
+TARGET_SSSE3 inline void unpackKmerSSSE3(const unsigned char* packed_kmer, char* kmer) {
+    int j = 0;
+    for (; j + 16 <= KMER_LEN; j += 16) {
+        unpack16(packed_kmer + j / 4, kmer + j);
+    }
+    if (j < KMER_LEN) {
+        unpack16Tail(packed_kmer + j / 4, kmer + j, KMER_LEN - j);
+    }
+}
+
+// The bulk loops, with the kernels inlined into them
+TARGET_SSSE3 void packKmersSSSE3(const char* kmers, size_t stride, size_t n,
+                                 unsigned char* packed_kmers, size_t packed_stride) {
+    for (size_t i = 0; i < n; i++) {
+        packKmerSSSE3(kmers + i * stride, packed_kmers + i * packed_stride);
+    }
+}
+
+TARGET_AVX2 void packKmersAVX2(const char* kmers, size_t stride, size_t n,
+                               unsigned char* packed_kmers, size_t packed_stride) {
+    for (size_t i = 0; i < n; i++) {
+        packKmerAVX2(kmers + i * stride, packed_kmers + i * packed_stride);
+    }
+}
+
+TARGET_SSSE3 void unpackKmersSSSE3(const unsigned char* packed_kmers, size_t packed_stride,
+                                   size_t n, char* kmers, size_t stride) {
+    for (size_t i = 0; i < n; i++) {
+        unpackKmerSSSE3(packed_kmers + i * packed_stride, kmers + i * stride);
+    }
+}
+#endif
+
+// Pack/unpack one k-mer with the widest kernels the CPU runs.
+void packKmer(const char* kmer, unsigned char* packed_kmer) {
+#if PACKING_VECTOR
+    if (packing_kernels == PACKING_AVX2) {
+        packKmerAVX2(kmer, packed_kmer);
+        return;
+    }
+    if (packing_kernels == PACKING_SSSE3) {
+        packKmerSSSE3(kmer, packed_kmer);
+        return;
+    }
+#endif
+    packKmerScalar(kmer, packed_kmer);
+}
+
+// Writes exactly KMER_LEN characters.
 void unpackKmer(const unsigned char packed_kmer[PACKED_KMER_LEN], char* kmer) {
-    if (!packedCodeToFourMerCoded) {
-        packedCodeToFourMerCoded = true;
-        init_LookupTable();
-    }
-    int i = 0, j = 0;
-    for (; i < PACKED_KMER_LEN; i++, j += 4) {
-        unsigned char block[4];
-        *(unsigned int*)block = packedCodeToFourMer[packed_kmer[i]];
-        for (int i = 0; i < 4; i++) {
-            (kmer + j)[i] = (char)block[i];
-        }
+#if PACKING_VECTOR
+    if (packing_kernels != PACKING_SCALAR) {
+        unpackKmerSSSE3(packed_kmer, kmer);
+        return;
+    }
+#endif
+    unpackKmerScalar(packed_kmer, kmer);
+}
+
+// Bulk conversion of n k-mers. K-mer i is read from (written to)
+// kmers + i * stride and packed_kmers + i * packed_stride, which lets
+// callers pack straight from text lines into arrays of records. The
+// kernels are picked once for the whole batch.
+void packKmers(const char* kmers, size_t stride, size_t n, unsigned char* packed_kmers,
+               size_t packed_stride) {
+#if PACKING_VECTOR
+    if (packing_kernels == PACKING_AVX2) {
+        packKmersAVX2(kmers, stride, n, packed_kmers, packed_stride);
+        return;
+    }
+    if (packing_kernels == PACKING_SSSE3) {
+        packKmersSSSE3(kmers, stride, n, packed_kmers, packed_stride);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        packKmerScalar(kmers + i * stride, packed_kmers + i * packed_stride);
+    }
+}
+
+void unpackKmers(const unsigned char* packed_kmers, size_t packed_stride, size_t n, char* kmers,
+                 size_t stride) {
+#if PACKING_VECTOR
+    if (packing_kernels != PACKING_SCALAR) {
+        unpackKmersSSSE3(packed_kmers, packed_stride, n, kmers, stride);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        unpackKmerScalar(packed_kmers + i * packed_stride, kmers + i * stride);
     }
 }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+
+#include "hash_policy.hpp"
 #include "packing.hpp"
 
 struct pkmer_t {
@@ -9,6 +13,22 @@ struct pkmer_t {
     std::string get() const noexcept;
     uint64_t hash() const noexcept;
 
+    // Hash with a specific policy from hash_policy.hpp
+    template <typename Hash> uint64_t hash(const Hash& hasher) const noexcept {
+        return hasher(data, PACKED_KMER_LEN);
+    }
+
+    // Hash of the k-mer's minimizer, the smallest of its m-mers (m <= 32)
+    // in the order of hasher over their 2-bit codes, so that poly-A and
+    // friends do not all land on one rank. Adjacent k-mers mostly share it.
+    template <typename Hash> uint64_t minimizer_hash(int m, const Hash& hasher) const noexcept;
+
+    // Shift a base in on the packed representation, without unpacking.
+    // shift_left drops the first base and appends base at the end,
+    // shift_right drops the last base and prepends base at the front.
+    pkmer_t shift_left(char base) const noexcept;
+    pkmer_t shift_right(char base) const noexcept;
+
     // Various C++ lifetime stuff.
     pkmer_t(const std::string& kmer);
 
@@ -29,11 +49,53 @@ std::string pkmer_t::get() const noexcept {
 }
 
 uint64_t pkmer_t::hash() const noexcept {
-    unsigned long hashval = 5381;
-    for (int i = 0; i < PACKED_KMER_LEN; i++) {
-        hashval = data[i] + (hashval << 5) + hashval;
+    return hash(DefaultKmerHash(DEFAULT_KMER_HASH_SEED));
+}
+
+template <typename Hash>
+uint64_t pkmer_t::minimizer_hash(int m, const Hash& hasher) const noexcept {
+    uint64_t mask = m == 32 ? ~uint64_t(0) : (uint64_t(1) << (2 * m)) - 1;
+    uint64_t mmer = 0;
+    uint64_t smallest = ~uint64_t(0);
+    for (int i = 0; i < KMER_LEN; i++) {
+        uint64_t code = (data[i / 4] >> (6 - 2 * (i % 4))) & 3;
+        mmer = ((mmer << 2) | code) & mask;
+        if (i >= m - 1) {
+            unsigned char bytes[8];
+            memcpy(bytes, &mmer, 8);
+            smallest = std::min(smallest, hasher(bytes, 8));
+        }
+    }
+    return smallest;
+}
+
+pkmer_t pkmer_t::shift_left(char base) const noexcept {
+    pkmer_t shifted;
+    for (int i = 0; i < PACKED_KMER_LEN - 1; i++) {
+        shifted.data[i] = (unsigned char)((data[i] << 2) | (data[i + 1] >> 6));
+    }
+    shifted.data[PACKED_KMER_LEN - 1] = (unsigned char)(data[PACKED_KMER_LEN - 1] << 2);
+
+    // The padding shifted into position KMER_LEN - 1 is zero
+    int pos = KMER_LEN - 1;
+    shifted.data[pos / 4] |= baseToCode.code[(unsigned char)base] << (6 - 2 * (pos % 4));
+    return shifted;
+}
+
+pkmer_t pkmer_t::shift_right(char base) const noexcept {
+    pkmer_t shifted;
+    for (int i = PACKED_KMER_LEN - 1; i > 0; i--) {
+        shifted.data[i] = (unsigned char)((data[i] >> 2) | (data[i - 1] << 6));
+    }
+    shifted.data[0] =
+        (unsigned char)((data[0] >> 2) | (baseToCode.code[(unsigned char)base] << 6));
+
+    // Keep the padding zero so packed k-mers compare bytewise
+    int pos = KMER_LEN;
+    if (pos < 4 * PACKED_KMER_LEN) {
+        shifted.data[pos / 4] &= (unsigned char)~(3 << (6 - 2 * (pos % 4)));
     }
-    return hashval;
+    return shifted;
 }
 
 pkmer_t::pkmer_t(const std::string& kmer) { packKmer(kmer.data(), data); }
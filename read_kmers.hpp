@@ -1,17 +1,124 @@
 #pragma once
 
+#include <algorithm>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "kmer_gzip.hpp"
 #include "kmer_t.hpp"
 
+// Binary k-mer files start with this header, followed by n_records
+// kmer_pair records exactly as they are in memory. kmer_convert writes them
+// from the text format.
+#define KMER_FILE_MAGIC "KMERPAK2"
+
+struct KmerFileHeader {
+    char magic[8];
+    uint32_t kmer_len;
+    uint32_t record_size;
+    uint64_t n_records;
+};
+
+// Fill header from the start of a file; false if it is not a binary k-mer file
+bool parse_kmer_header(const char* data, size_t size, KmerFileHeader& header) {
+    if (size < sizeof(KmerFileHeader) || memcmp(data, KMER_FILE_MAGIC, 8) != 0) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(KmerFileHeader));
+    return true;
+}
+
+bool read_kmer_header(const std::string& fname, KmerFileHeader& header) {
+    FILE* f = fopen(fname.c_str(), "rb");
+    if (f == NULL) {
+        throw std::runtime_error("could not open " + fname);
+    }
+    char buf[sizeof(KmerFileHeader)];
+    size_t n_read = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    return parse_kmer_header(buf, n_read, header);
+}
+
+// Inflate block i of a block-compressed file held in data into raw
+void read_kgz_block(const char* data, const KgzFooter& footer, size_t i, std::vector<char>& raw) {
+    KgzBlock block = kgz_block(data, footer, i);
+    raw.resize(block.raw_size);
+    inflate_block(data + block.offset, block.size, raw.data(), raw.size());
+}
+
+// A file mapped read-only into memory; pages are only read when touched.
+struct MappedFile {
+    int fd;
+    const char* data;
+    size_t size;
+
+    MappedFile(const std::string& fname);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+MappedFile::MappedFile(const std::string& fname) {
+    fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("could not open " + fname);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size = st.st_size;
+    data = nullptr;
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("could not map " + fname);
+        }
+        data = (const char*)mapped;
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        munmap((void*)data, size);
+    }
+    close(fd);
+}
+
 // Return the size of the k-mers in fname
 int kmer_size(const std::string& fname) {
+    KmerFileHeader header;
+    if (read_kmer_header(fname, header)) {
+        return header.kmer_len;
+    }
+
+    // Compressed files: the first token of the first block
+    KgzFooter footer;
+    if (read_kgz_footer(fname, footer)) {
+        MappedFile file(fname);
+        std::vector<char> raw;
+        if (parse_kgz_footer(file.data, file.size, footer) && footer.n_blocks > 0) {
+            read_kgz_block(file.data, footer, 0, raw);
+        }
+        return std::find_if(raw.begin(), raw.end(), [](char c) { return isspace(c); }) - raw.begin();
+    }
+
     std::ifstream fin(fname);
     if (!fin.is_open()) {
         throw std::runtime_error("kmer_size: could not open " + fname);
@@ -24,69 +131,185 @@ int kmer_size(const std::string& fname) {
     return buf.size();
 }
 
+// First '\n' in [from, to), or to if there is none.
+const char* find_newline(const char* from, const char* to) {
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; from + 16 <= to; from += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)from);
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+        if (mask != 0) {
+            return from + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; from < to; from++) {
+        if (*from == '\n') {
+            return from;
+        }
+    }
+    return to;
+}
+
+size_t count_newlines(const char* from, const char* to) {
+    size_t n = 0;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; from + 16 <= to; from += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)from);
+        n += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+    }
+#endif
+    for (; from < to; from++) {
+        n += *from == '\n';
+    }
+    return n;
+}
+
 // Get the number of lines in fname
+// (for binary files, the number of records)
 size_t line_count(const std::string& fname) {
-    FILE* f = fopen(fname.c_str(), "r");
-    if (f == NULL) {
-        throw std::runtime_error("line_count: could not open " + fname);
+    KmerFileHeader header;
+    if (read_kmer_header(fname, header)) {
+        return header.n_records;
+    }
+    KgzFooter footer;
+    if (read_kgz_footer(fname, footer)) {
+        return footer.n_kmers;
     }
-    size_t n_lines = 0;
-    int n_read;
+    MappedFile file(fname);
+    return count_newlines(file.data, file.data + file.size);
+}
 
-    const size_t buf_size = 16384;
-    char buf[buf_size];
+// Number of k-mers in fname, from its size alone. Lines are KMER_LEN + 4
+// bytes ("kmer fb\n"), so this is exact for such files and an overestimate
+// for CRLF ones, and needs no pass over the file. Binary and compressed
+// files record it.
+size_t kmer_count_estimate(const std::string& fname) {
+    KmerFileHeader header;
+    if (read_kmer_header(fname, header)) {
+        return header.n_records;
+    }
+    KgzFooter footer;
+    if (read_kgz_footer(fname, footer)) {
+        return footer.n_kmers;
+    }
 
-    do {
-        n_read = fread(buf, sizeof(char), buf_size, f);
-        for (int i = 0; i < n_read; i++) {
-            if (buf[i] == '\n') {
-                n_lines++;
-            }
-        }
-    } while (n_read != 0);
-    fclose(f);
-    return n_lines;
+    struct stat st;
+    if (stat(fname.c_str(), &st) != 0) {
+        throw std::runtime_error("kmer_count_estimate: could not open " + fname);
+    }
+    return st.st_size / (KMER_LEN + 4);
 }
 
-// Read k-mers from fname.
-// If nprocs and rank are given, each rank will read
-// an appropriately sized block portion of the k-mers.
-std::vector<kmer_pair> read_kmers(const std::string& fname, int nprocs = 1, int rank = 0) {
-    size_t num_lines = line_count(fname);
-    size_t split = (num_lines + nprocs - 1) / nprocs;
-    size_t start = split * rank;
-    size_t size = std::min(split, num_lines - start);
-
-    FILE* f = fopen(fname.c_str(), "r");
-    if (f == NULL) {
-        throw std::runtime_error("read_kmers: could not open " + fname);
+// Start of the first line beginning at or after offset
+size_t line_start(const char* data, size_t size, size_t offset) {
+    if (offset == 0 || offset >= size) {
+        return std::min(offset, size);
     }
-    const size_t line_len = KMER_LEN + 4;
-    fseek(f, line_len * start, SEEK_SET);
+    return find_newline(data + offset - 1, data + size) - data + 1;
+}
 
-    std::shared_ptr<char> buf(new char[line_len * size]);
-    fread(buf.get(), sizeof(char), line_len * size, f);
+// Pack up to max_kmers lines from [p, stop) into out, counting them in
+// n_kmers. Lines are "kmer fb" with any one separator byte, ending in LF or
+// CRLF, or at stop; blank lines are skipped, and shorter lines throw.
+// Returns where parsing stopped.
+const char* parse_kmers(const char* p, const char* stop, kmer_pair* out, size_t max_kmers,
+                        size_t& n_kmers) {
+    n_kmers = 0;
+    while (p < stop && n_kmers < max_kmers) {
+        const char* eol = find_newline(p, stop);
+        const char* line_end = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
 
-    std::vector<kmer_pair> kmers;
+        if (line_end - p >= KMER_LEN + 3) {
+            kmer_pair& kmer = out[n_kmers++];
+            packKmer(p, kmer.kmer.data);
+            kmer.fb_ext[0] = p[KMER_LEN + 1];
+            kmer.fb_ext[1] = p[KMER_LEN + 2];
+        } else if (line_end != p) {
+            throw std::runtime_error("parse_kmers: malformed line of " +
+                                     std::to_string(line_end - p) + " bytes");
+        }
+        p = eol < stop ? eol + 1 : stop;
+    }
+    return p;
+}
 
-    for (size_t line_offset = 0; line_offset < line_len * size; line_offset += line_len) {
-        char* kmer_buf = &buf.get()[line_offset];
-        char* fb_ext_buf = kmer_buf + KMER_LEN + 1;
-        kmers.push_back(kmer_pair(std::string(kmer_buf, KMER_LEN), std::string(fb_ext_buf, 2)));
+// Byte range [first, last) of fname's mapping that belongs to rank. Text
+// files are split evenly by bytes; a line belongs to the rank whose range
+// contains its first byte. Binary files are split evenly by records.
+// Returns whether the file is binary.
+bool rank_range(const MappedFile& file, int nprocs, int rank, size_t& first, size_t& last) {
+    KmerFileHeader header;
+    if (!parse_kmer_header(file.data, file.size, header)) {
+        first = line_start(file.data, file.size, file.size * rank / nprocs);
+        last = line_start(file.data, file.size, file.size * (rank + 1) / nprocs);
+        return false;
     }
-    fclose(f);
-    return kmers;
+
+    if (header.kmer_len != KMER_LEN || header.record_size != sizeof(kmer_pair)) {
+        throw std::runtime_error("binary k-mer file was written for " +
+                                 std::to_string(header.kmer_len) + "-mers");
+    }
+    size_t records = sizeof(KmerFileHeader);
+    if (header.n_records > (file.size - records) / sizeof(kmer_pair)) {
+        throw std::runtime_error("binary k-mer file is truncated");
+    }
+
+    uint64_t first_record = header.n_records * rank / nprocs;
+    uint64_t last_record = header.n_records * (rank + 1) / nprocs;
+    first = records + first_record * sizeof(kmer_pair);
+    last = records + last_record * sizeof(kmer_pair);
+    return true;
 }
 
-std::string extract_contig(const std::list<kmer_pair>& contig) {
-    std::string contig_buf = "";
+// Read k-mers from fname.
+// If nprocs and rank are given, each rank will read
+// an appropriately sized block portion of the k-mers.
+//
+// The file is memory-mapped and each line is packed straight from the
+// mapping into the output array. Binary files are copied as they are, and
+// of block-compressed files each rank inflates only its own blocks.
+std::vector<kmer_pair> read_kmers(const std::string& fname, int nprocs = 1, int rank = 0) {
+    MappedFile file(fname);
 
-    contig_buf += contig.front().kmer_str();
+    KgzFooter footer;
+    if (parse_kgz_footer(file.data, file.size, footer)) {
+        size_t first_block, last_block;
+        kgz_rank_blocks(footer, nprocs, rank, first_block, last_block);
+        uint64_t first_kmer = first_block < footer.n_blocks
+                                  ? kgz_block(file.data, footer, first_block).first_kmer
+                                  : footer.n_kmers;
+        uint64_t last_kmer = last_block < footer.n_blocks
+                                 ? kgz_block(file.data, footer, last_block).first_kmer
+                                 : footer.n_kmers;
 
-    for (const auto& kmer : contig) {
-        if (kmer.forwardExt() != 'F') {
-            contig_buf += kmer.forwardExt();
+        std::vector<kmer_pair> kmers(last_kmer - first_kmer);
+        std::vector<char> raw;
+        size_t n = 0;
+        for (size_t i = first_block; i < last_block; i++) {
+            read_kgz_block(file.data, footer, i, raw);
+            size_t parsed;
+            parse_kmers(raw.data(), raw.data() + raw.size(), kmers.data() + n, kmers.size() - n,
+                        parsed);
+            n += parsed;
         }
+        kmers.resize(n);
+        return kmers;
     }
-    return contig_buf;
+
+    size_t first, last;
+    if (rank_range(file, nprocs, rank, first, last)) {
+        std::vector<kmer_pair> kmers((last - first) / sizeof(kmer_pair));
+        memcpy((void*)kmers.data(), file.data + first, last - first);
+        return kmers;
+    }
+
+    // Every line but possibly the last has at least KMER_LEN + 4 bytes
+    std::vector<kmer_pair> kmers((last - first) / (KMER_LEN + 4) + 1);
+    size_t n;
+    parse_kmers(file.data + first, file.data + last, kmers.data(), kmers.size(), n);
+
+    kmers.resize(n);
+    return kmers;
 }
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "counters.hpp"
+#include "kmer_entry.hpp"
+#include "kmer_run.hpp"
+#include "kmer_t.hpp"
+#include "trace.hpp"
+
+#define BUFFER_SIZE 32
+
+// Ships k-mers to their owners in batches of BUFFER_SIZE, one RPC each,
+// and finds them with one RPC per run, which the owner follows as far as
+// the contig stays on it. The handlers insert into the owner's partition
+// while its own threads may too, so the Storage needs a locked insert,
+// like GrowableTable.
+template <typename Map> struct RpcTransport {
+    // Aggregation state for one inserting thread
+    struct SendBuffers {
+        // One aggregation buffer per destination rank, in wire format
+        std::vector<std::vector<wire_entry>> buff;
+
+        // Batches sent but not yet acknowledged, and whether any of them
+        // could not be placed in the owner's table
+        upcxx::future<> pending;
+        bool failed;
+
+        SendBuffers();
+    };
+
+    Map& map;
+
+    RpcTransport(Map& map1);
+
+    // Place a k-mer whose owner is given; false means it did not fit. Remote
+    // k-mers are only buffered, and flush() reports whether they fit.
+    bool insert(const kmer_pair& kmer, uint64_t hash, int owner, SendBuffers& buffers);
+
+    // Send the partially filled buffers and wait until the owners have
+    // inserted everything sent with these buffers
+    bool flush(SendBuffers& buffers);
+
+    // Look up a k-mer another rank owns, with up to depth k-mers of its run
+    upcxx::future<kmer_run> find(const pkmer_t& key_kmer, uint64_t hash, int owner, int depth);
+
+    void send_buffer(int target_rank, SendBuffers& buffers);
+};
+
+template <typename Map> RpcTransport<Map>::SendBuffers::SendBuffers() {
+    buff.resize(upcxx::rank_n());
+    for (auto& buf : buff) {
+        buf.reserve(BUFFER_SIZE);
+    }
+    pending = upcxx::make_future();
+    failed = false;
+}
+
+template <typename Map> RpcTransport<Map>::RpcTransport(Map& map1) : map(map1) {}
+
+template <typename Map>
+bool RpcTransport<Map>::insert(const kmer_pair& kmer, uint64_t hash, int owner,
+                               SendBuffers& buffers) {
+    // Our own k-mers skip the buffers entirely
+    if (owner == upcxx::rank_me()) {
+        return map.local.insert(kmer, hash);
+    }
+
+    // Add the kmer to the buffer and ship it once it is full
+    buffers.buff[owner].push_back(wire_entry::pack(kmer_entry::pack(kmer)));
+    if (buffers.buff[owner].size() == BUFFER_SIZE) {
+        send_buffer(owner, buffers);
+
+        // Let batches sent to us be inserted while we keep producing
+        upcxx::progress();
+    }
+
+    return true;
+}
+
+template <typename Map> bool RpcTransport<Map>::flush(SendBuffers& buffers) {
+    for (int target_rank = 0; target_rank < upcxx::rank_n(); target_rank++) {
+        if (!buffers.buff[target_rank].empty()) {
+            send_buffer(target_rank, buffers);
+        }
+    }
+
+    // Wait until every owner has inserted what we sent it
+    {
+        TRACE_SPAN("drain buffers");
+        buffers.pending.wait();
+    }
+    buffers.pending = upcxx::make_future();
+
+    return !buffers.failed;
+}
+
+template <typename Map> void RpcTransport<Map>::send_buffer(int target_rank, SendBuffers& buffers) {
+    TRACE_INSTANT("send batch", buffers.buff[target_rank].size());
+    COUNT(counters().buffer_flushes++;
+          counters().count_rpc(target_rank, buffers.buff[target_rank].size() * sizeof(wire_entry)));
+
+    // The view is serialized at injection, so the buffer can be reused right away
+    upcxx::future<> sent =
+        upcxx::rpc(
+            target_rank,
+            [](upcxx::dist_object<Map*>& dst_map, upcxx::view<wire_entry> batch) {
+                TRACE_SPAN_ARG("insert batch", batch.size());
+                Map& owner_map = **dst_map;
+
+                // Probe every k-mer straight out of the network buffer
+                for (const wire_entry& wire : batch) {
+                    kmer_entry entry = wire.unpack();
+                    if (!owner_map.local.insert(entry, owner_map.hash(entry.kmer()))) {
+                        return false;
+                    }
+                }
+                return true;
+            },
+            map.self,
+            upcxx::make_view(buffers.buff[target_rank].begin(), buffers.buff[target_rank].end()))
+            .then([&buffers](bool inserted) {
+                if (!inserted) {
+                    buffers.failed = true;
+                }
+            });
+
+    buffers.pending = upcxx::when_all(buffers.pending, sent);
+    buffers.buff[target_rank].clear();
+}
+
+template <typename Map>
+upcxx::future<kmer_run> RpcTransport<Map>::find(const pkmer_t& key_kmer, uint64_t hash, int owner,
+                                                int depth) {
+    return upcxx::rpc(
+        owner,
+        [](upcxx::dist_object<Map*>& dst_map, const pkmer_t& key_kmer, uint64_t hash, int depth) {
+            TRACE_SPAN("find handler");
+            return (*dst_map)->find_run(key_kmer, hash, depth);
+        },
+        map.self, key_kmer, hash, depth);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdexcept>
+#include <upcxx/upcxx.hpp>
+
+#include "kmer_run.hpp"
+#include "kmer_t.hpp"
+
+// Keeps every k-mer in this rank's partition: no messages and no
+// buffering, for single-rank runs and as the baseline the others are
+// measured against.
+template <typename Map> struct SerialTransport {
+    struct SendBuffers {};
+
+    Map& map;
+
+    SerialTransport(Map& map1);
+
+    bool insert(const kmer_pair& kmer, uint64_t hash, int owner, SendBuffers& buffers);
+    bool flush(SendBuffers& buffers);
+
+    // Every k-mer is owned here, so this is never called
+    upcxx::future<kmer_run> find(const pkmer_t& key_kmer, uint64_t hash, int owner, int depth);
+};
+
+template <typename Map> SerialTransport<Map>::SerialTransport(Map& map1) : map(map1) {
+    if (upcxx::rank_n() > 1) {
+        throw std::runtime_error("Error: the serial transport runs on one rank only.");
+    }
+}
+
+template <typename Map>
+bool SerialTransport<Map>::insert(const kmer_pair& kmer, uint64_t hash, int, SendBuffers&) {
+    return map.local.insert(kmer, hash);
+}
+
+template <typename Map> bool SerialTransport<Map>::flush(SendBuffers&) { return true; }
+
+template <typename Map>
+upcxx::future<kmer_run> SerialTransport<Map>::find(const pkmer_t&, uint64_t, int, int) {
+    return upcxx::make_future(kmer_run{});
+}
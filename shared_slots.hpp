@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <upcxx/upcxx.hpp>
+
+#include "hash_policy.hpp"
+#include "kmer_entry.hpp"
+#include "kmer_t.hpp"
+
+// When a whole kmer_entry fits in 64 bits the CAS publishes the k-mer and
+// its extensions at once, and the extension array is not used
+#if KMER_LEN <= 29
+#define ENTRY_IN_KEY_WORD 1
+#else
+#define ENTRY_IN_KEY_WORD 0
+#endif
+
+// Slots per requested slot. The arrays cannot grow, so they leave room for
+// ranks that get more than their share.
+#define SHARED_SLOTS_SLACK 2
+
+// One rank's partition in the shared segment, laid out for one-sided access
+// by AtomicTransport. A slot is claimed by CASing its key word from 0 to
+// slot_word(kmer), so occupancy is in-band. Unless the key word is a whole
+// kmer_entry, the extensions, and for large K the full packed k-mers, are
+// kept in separate arrays that are only read on a hit. Probing is linear
+// from first_slot(hash), and nothing is ever removed.
+//
+// Other ranks fill the partition with remote atomics, so its own rank only
+// reads it, and only once every insert has landed.
+struct SharedSlots {
+    // Where a partition's arrays are, for the ranks that probe it
+    struct Pointers {
+        upcxx::global_ptr<uint64_t> keys;
+        upcxx::global_ptr<uint16_t> exts;
+        upcxx::global_ptr<pkmer_t> kmers;
+    };
+
+    Pointers arrays;
+    size_t n_slots;
+
+    // Always 0; the arrays have a fixed size
+    int n_grows;
+
+    SharedSlots(size_t min_capacity);
+    ~SharedSlots();
+
+    SharedSlots(const SharedSlots&) = delete;
+    SharedSlots& operator=(const SharedSlots&) = delete;
+
+    // size() counts the claimed slots
+    size_t size() const noexcept;
+    size_t capacity() const noexcept;
+
+    // Where probing starts. The owner is picked from the low bits of the
+    // hash, so the slot is taken from a remix of it.
+    size_t first_slot(uint64_t hash) const noexcept;
+
+    bool find(const pkmer_t& key_kmer, uint64_t hash, kmer_entry& val_entry) const;
+    bool find(const pkmer_t& key_kmer, uint64_t hash, kmer_pair& val_kmer) const;
+
+    // Nonzero word published in a claimed slot: the kmer_entry if it fits,
+    // else key_word(). probe_key() is what a lookup matches slot words with.
+    static uint64_t slot_word(const kmer_pair& kmer) noexcept;
+    static uint64_t probe_key(const pkmer_t& kmer) noexcept;
+    static bool slot_has_key(uint64_t slot_word, uint64_t key) noexcept;
+
+    // When the packed k-mer fits in 63 bits key_word is the k-mer itself,
+    // otherwise a fingerprint of it.
+    static uint64_t key_word(const pkmer_t& kmer) noexcept;
+    static bool key_word_exact() noexcept;
+    static bool entry_in_key_word() noexcept;
+};
+
+SharedSlots::SharedSlots(size_t min_capacity)
+    : n_slots(min_capacity * SHARED_SLOTS_SLACK), n_grows(0) {
+    // Every array starts on a cache line
+    arrays.keys = upcxx::allocate<uint64_t, 64>(n_slots);
+    if (!entry_in_key_word()) {
+        arrays.exts = upcxx::allocate<uint16_t, 64>(n_slots);
+    }
+    if (!key_word_exact()) {
+        arrays.kmers = upcxx::allocate<pkmer_t, 64>(n_slots);
+    }
+    if (arrays.keys.is_null() || (!entry_in_key_word() && arrays.exts.is_null()) ||
+        (!key_word_exact() && arrays.kmers.is_null())) {
+        throw std::runtime_error("Error: out of shared memory for the hash table.");
+    }
+
+    // Empty key words are 0
+    memset(arrays.keys.local(), 0, n_slots * sizeof(uint64_t));
+}
+
+SharedSlots::~SharedSlots() {
+    upcxx::deallocate(arrays.keys);
+    upcxx::deallocate(arrays.exts);
+    upcxx::deallocate(arrays.kmers);
+}
+
+size_t SharedSlots::size() const noexcept {
+    const uint64_t* keys = arrays.keys.local();
+    size_t n = 0;
+    for (size_t slot = 0; slot < n_slots; slot++) {
+        n += keys[slot] != 0;
+    }
+    return n;
+}
+
+size_t SharedSlots::capacity() const noexcept { return n_slots; }
+
+size_t SharedSlots::first_slot(uint64_t hash) const noexcept {
+    return Mix64Hash::fmix64(hash) % n_slots;
+}
+
+bool SharedSlots::find(const pkmer_t& key_kmer, uint64_t hash, kmer_entry& val_entry) const {
+    const uint64_t* keys = arrays.keys.local();
+    uint64_t key = probe_key(key_kmer);
+    size_t slot = first_slot(hash);
+
+    for (size_t probe = 0; probe < n_slots; probe++, slot = (slot + 1) % n_slots) {
+        uint64_t word = keys[slot];
+
+        // Nothing is ever removed, so an empty slot ends the probe sequence
+        if (word == 0) {
+            return false;
+        }
+        if (!slot_has_key(word, key)) {
+            continue;
+        }
+#if ENTRY_IN_KEY_WORD
+        val_entry = kmer_entry{word};
+        return true;
+#else
+        kmer_pair kmer;
+        kmer.kmer = key_word_exact() ? key_kmer : arrays.kmers.local()[slot];
+        memcpy(kmer.fb_ext, &arrays.exts.local()[slot], 2);
+        if (kmer.kmer == key_kmer) {
+            val_entry = kmer_entry::pack(kmer);
+            return true;
+        }
+#endif
+    }
+    return false;
+}
+
+bool SharedSlots::find(const pkmer_t& key_kmer, uint64_t hash, kmer_pair& val_kmer) const {
+    kmer_entry entry;
+    if (!find(key_kmer, hash, entry)) {
+        return false;
+    }
+    val_kmer = entry.unpack();
+    return true;
+}
+
+uint64_t SharedSlots::slot_word(const kmer_pair& kmer) noexcept {
+#if ENTRY_IN_KEY_WORD
+    return kmer_entry::pack(kmer).word;
+#else
+    return key_word(kmer.kmer);
+#endif
+}
+
+uint64_t SharedSlots::probe_key(const pkmer_t& kmer) noexcept {
+#if ENTRY_IN_KEY_WORD
+    return kmer_entry::key(kmer);
+#else
+    return key_word(kmer);
+#endif
+}
+
+bool SharedSlots::slot_has_key(uint64_t slot_word, uint64_t key) noexcept {
+#if ENTRY_IN_KEY_WORD
+    return kmer_entry{slot_word}.has_key(key);
+#else
+    return slot_word == key;
+#endif
+}
+
+uint64_t SharedSlots::key_word(const pkmer_t& kmer) noexcept {
+    if (!key_word_exact()) {
+        return kmer.hash() | 1;
+    }
+
+    // Bases fill the word from the top, so bit 0 is always padding
+    uint64_t word = 0;
+    for (int i = 0; i < PACKED_KMER_LEN; i++) {
+        word |= (uint64_t)kmer.data[i] << (56 - 8 * i);
+    }
+    return word | 1;
+}
+
+bool SharedSlots::key_word_exact() noexcept { return 2 * KMER_LEN < 64; }
+
+bool SharedSlots::entry_in_key_word() noexcept { return ENTRY_IN_KEY_WORD; }
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "check.hpp"
+#include "contig_writer.hpp"
+
+// The shared contig file: every rank's chunks and remainders land at their
+// own offsets, with or without flushing each line, and a writer that is
+// never closed still lets go of its resources.
+
+// Contig i of rank, long enough every few lines to fill a chunk on its own
+std::string test_contig(int rank, int i) {
+    size_t length = i % 50 == 0 ? OUTPUT_CHUNK + 17 : 100 + (i * 37 + rank) % 900;
+    std::string contig = std::to_string(rank) + ":" + std::to_string(i) + ":";
+    contig.resize(length, "ACGT"[(rank + i) % 4]);
+    return contig;
+}
+
+void test_offsets(bool flush_lines, int n_contigs) {
+    const std::string fname = "test_contig_writer_" + std::to_string(KMER_LEN) + ".dat";
+    {
+        ContigWriter output(fname, flush_lines);
+        for (int i = 0; i < n_contigs; i++) {
+            output.add(test_contig(upcxx::rank_me(), i));
+            output.pump();
+        }
+        output.close();
+    }
+    upcxx::barrier();
+
+    if (upcxx::rank_me() == 0) {
+        std::vector<std::string> expected, lines;
+        size_t expected_size = 0;
+        for (int rank = 0; rank < upcxx::rank_n(); rank++) {
+            for (int i = 0; i < n_contigs; i++) {
+                expected.push_back(test_contig(rank, i));
+                expected_size += expected.back().size() + 1;
+            }
+        }
+
+        FILE* f = fopen(fname.c_str(), "rb");
+        CHECK(f != NULL);
+        std::string text(expected_size + 1, '\0');
+        size_t n_read = f ? fread(&text[0], 1, text.size(), f) : 0;
+        if (f) {
+            fclose(f);
+        }
+        CHECK(n_read == expected_size);
+        text.resize(n_read);
+
+        size_t start = 0;
+        for (size_t end; (end = text.find('\n', start)) != std::string::npos; start = end + 1) {
+            lines.push_back(text.substr(start, end - start));
+        }
+        CHECK(start == text.size());
+        std::sort(expected.begin(), expected.end());
+        std::sort(lines.begin(), lines.end());
+        CHECK(lines == expected);
+        remove(fname.c_str());
+    }
+    upcxx::barrier();
+}
+
+// Dropping a writer that was never closed, as an exception would, does not hang
+void test_unclosed() {
+    const std::string fname = "test_contig_writer_" + std::to_string(KMER_LEN) + ".tmp";
+    {
+        ContigWriter output(fname, false);
+        output.add(test_contig(upcxx::rank_me(), 1));
+        output.pump();
+        output.wait_claims();
+    }
+    upcxx::barrier();
+    if (upcxx::rank_me() == 0) {
+        remove(fname.c_str());
+    }
+}
+
+int main() {
+    upcxx::init();
+    test_offsets(false, 200);
+    test_offsets(true, 120);
+    test_offsets(false, 0);
+    test_unclosed();
+    int result = check_result();
+    upcxx::finalize();
+    return result;
+}
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "check.hpp"
+#include "hash_map.hpp"
+#include "kmer_t.hpp"
+
+// Owners under minimizer partitioning: the minimizer is ordered by the
+// map's own hash policy, every rank agrees on each k-mer's owner, and what
+// one rank inserts every rank finds, over every transport that runs on
+// several ranks.
+
+// The k-mers of random contigs, with their extensions
+std::vector<kmer_pair> contig_kmers(int n_contigs, int contig_len) {
+    std::mt19937_64 rng(11);
+    std::vector<kmer_pair> kmers;
+    for (int c = 0; c < n_contigs; c++) {
+        std::string seq;
+        for (int i = 0; i < contig_len; i++) {
+            seq += "ACGT"[rng() % 4];
+        }
+        for (int i = 0; i + KMER_LEN <= contig_len; i++) {
+            std::string fb;
+            fb += i == 0 ? 'F' : seq[i - 1];
+            fb += i + KMER_LEN == contig_len ? 'F' : seq[i + KMER_LEN];
+            kmers.push_back(kmer_pair(seq.substr(i, KMER_LEN), fb));
+        }
+    }
+    return kmers;
+}
+
+// The minimizer hash straight from the k-mer's text: the smallest hash of
+// the 2-bit codes of each m-mer
+template <typename Hash>
+uint64_t text_minimizer_hash(const std::string& kmer, int m, const Hash& hasher) {
+    uint64_t smallest = ~uint64_t(0);
+    for (int i = 0; i + m <= KMER_LEN; i++) {
+        uint64_t mmer = 0;
+        for (int j = i; j < i + m; j++) {
+            mmer = (mmer << 2) | std::string("ACGT").find(kmer[j]);
+        }
+        unsigned char bytes[8];
+        memcpy(bytes, &mmer, 8);
+        smallest = std::min(smallest, hasher(bytes, 8));
+    }
+    return smallest;
+}
+
+template <typename Hash>
+void test_minimizer_hash(const std::vector<kmer_pair>& kmers, const Hash& hasher) {
+    for (int m : {1, 7, MINIMIZER_LEN, std::min(KMER_LEN, 32)}) {
+        for (size_t i = 0; i < kmers.size(); i += 13) {
+            CHECK(kmers[i].kmer.minimizer_hash(m, hasher) ==
+                  text_minimizer_hash(kmers[i].kmer_str(), m, hasher));
+        }
+    }
+}
+
+// Inserted from every rank, found from every rank, each k-mer on the owner
+// of its minimizer under the map's hasher
+template <typename Map> void test_owners(const std::vector<kmer_pair>& kmers, int minimizer_len) {
+    size_t table_size = 2 * kmers.size();
+    Map map(table_size, table_size / upcxx::rank_n() + 1);
+    map.minimizer_len = minimizer_len;
+
+    for (size_t i = upcxx::rank_me(); i < kmers.size(); i += upcxx::rank_n()) {
+        CHECK(map.insert(kmers[i]));
+    }
+    CHECK(map.send_all_buffers());
+    upcxx::barrier();
+
+    size_t held = 0;
+    for (const kmer_pair& kmer : kmers) {
+        uint64_t hash = minimizer_len != 0
+                            ? text_minimizer_hash(kmer.kmer_str(), minimizer_len, map.hasher)
+                            : kmer.kmer.hash(map.hasher);
+        int owner = map.owner(kmer.kmer, map.hash(kmer.kmer));
+        CHECK(owner == int((hash % map.size()) / map.local_size()));
+        held += owner == upcxx::rank_me();
+
+        kmer_pair found;
+        CHECK(map.find(kmer.kmer, found));
+        CHECK(found == kmer);
+    }
+    CHECK(map.local.size() == held);
+    upcxx::barrier();
+}
+
+int main() {
+    upcxx::init();
+    std::vector<kmer_pair> kmers = contig_kmers(20, 300);
+
+    test_minimizer_hash(kmers, Mix64Hash(0));
+    test_minimizer_hash(kmers, Mix64Hash(12345));
+    test_minimizer_hash(kmers, Djb2Hash());
+
+    // A different seed orders the m-mers differently
+    size_t differ = 0;
+    for (const kmer_pair& kmer : kmers) {
+        differ += kmer.kmer.minimizer_hash(MINIMIZER_LEN, Mix64Hash(1)) !=
+                  kmer.kmer.minimizer_hash(MINIMIZER_LEN, Mix64Hash(2));
+    }
+    CHECK(differ > kmers.size() / 2);
+
+    for (int minimizer_len : {0, MINIMIZER_LEN}) {
+        test_owners<RpcHashMap>(kmers, minimizer_len);
+        test_owners<AtomicHashMap>(kmers, minimizer_len);
+        test_owners<MailboxHashMap>(kmers, minimizer_len);
+        test_owners<HashMap<BasicGrowableTable<Djb2Hash>, RpcTransport, Djb2Hash>>(kmers,
+                                                                                    minimizer_len);
+    }
+
+    int result = check_result();
+    upcxx::finalize();
+    return result;
+}
@@ -0,0 +1,146 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+#include "kmer_t.hpp"
+#include "local_table.hpp"
+
+// The local tables: probing reaches every group, each slot layout and the
+// wire form give back what was put in, and a growing table keeps every
+// k-mer through its grows and the migrations between them, also when
+// several threads insert at once.
+
+// Distinct k-mers, the i-th one spelling i in base 4
+kmer_pair make_kmer(size_t i, const char* fb = "AC") {
+    std::string kmer(KMER_LEN, 'A');
+    for (int j = KMER_LEN - 1; j >= 0 && i != 0; j--, i /= 4) {
+        kmer[j] = "ACGT"[i % 4];
+    }
+    return kmer_pair(kmer, fb);
+}
+
+// With as many groups as a probe may visit, k-mers that all start in the
+// same group fill every slot before one goes to the stash
+template <typename Slots> void test_probe_reaches_every_group() {
+    BasicLocalTable<Slots> table(MAX_PROBE_GROUPS * GROUP_WIDTH - 40);
+    CHECK(table.groups() == MAX_PROBE_GROUPS);
+
+    const uint64_t hash = 0x5A5;
+    for (size_t i = 0; i < table.capacity(); i++) {
+        CHECK(table.insert(make_kmer(i), hash));
+    }
+    CHECK(table.stash_used == 0);
+
+    CHECK(table.insert(make_kmer(table.capacity(), "FG"), hash));
+    CHECK(table.stash_used == 1);
+
+    for (size_t i = 0; i <= table.capacity(); i++) {
+        kmer_pair found;
+        CHECK(table.find(make_kmer(i).kmer, hash, found));
+        CHECK(found == make_kmer(i, i == table.capacity() ? "FG" : "AC"));
+    }
+    kmer_pair found;
+    CHECK(!table.find(make_kmer(table.capacity() + 1).kmer, hash, found));
+}
+
+// Wire entries are 2K + 6 bits rounded up to bytes and give back the entry
+void test_wire_entries() {
+#if KMER_LEN <= 61
+    CHECK(sizeof(wire_entry) == (2 * KMER_LEN + 6 + 7) / 8);
+#endif
+    for (size_t i : {size_t(0), size_t(1), size_t(12345), ~size_t(0) >> 1}) {
+        for (const char* fb : {"AC", "FT", "GF", "FF"}) {
+            kmer_pair kmer = make_kmer(i, fb);
+            kmer_entry entry = wire_entry::pack(kmer_entry::pack(kmer)).unpack();
+            CHECK(entry.unpack() == kmer);
+        }
+    }
+}
+
+// Group counts are powers of two, whatever capacity is asked for
+void test_group_counts() {
+    for (size_t min_capacity : {0, 1, 16, 17, 1000, 4096, 4097}) {
+        LocalTable table(min_capacity);
+        CHECK(table.capacity() >= min_capacity);
+        CHECK((table.groups() & (table.groups() - 1)) == 0);
+        CHECK(table.capacity() < 2 * min_capacity + 2 * GROUP_WIDTH);
+    }
+}
+
+// A table started small keeps every k-mer through its grows, including
+// while the groups of the old table are still being moved
+void test_grow_and_migrate() {
+    GrowableTable table(16);
+    const size_t n_kmers = 20000;
+    bool checked_migration = false;
+    for (size_t i = 0; i < n_kmers; i++) {
+        kmer_pair kmer = make_kmer(i, "GT");
+        CHECK(table.insert(kmer, kmer.kmer.hash(table.hasher)));
+
+        // Mid-migration, k-mers are found in the old table and the new one
+        if (table.old_table && i % 97 == 0) {
+            checked_migration = true;
+            for (size_t j = 0; j <= i; j++) {
+                kmer_pair found;
+                CHECK(table.find(make_kmer(j).kmer, make_kmer(j).kmer.hash(table.hasher), found));
+                CHECK(found == make_kmer(j, "GT"));
+            }
+        }
+    }
+    CHECK(checked_migration);
+    CHECK(table.n_grows > 0);
+    CHECK(table.size() == n_kmers);
+    CHECK(table.capacity() * MAX_LOAD_FACTOR >= n_kmers);
+
+    for (size_t i = 0; i < n_kmers; i++) {
+        kmer_pair found;
+        CHECK(table.find(make_kmer(i).kmer, make_kmer(i).kmer.hash(table.hasher), found));
+        CHECK(found == make_kmer(i, "GT"));
+    }
+    kmer_pair found;
+    CHECK(!table.find(make_kmer(n_kmers).kmer, make_kmer(n_kmers).kmer.hash(table.hasher), found));
+}
+
+// Threads inserting into one small table at once grow it many times over,
+// and every k-mer is there once they are done
+void test_threaded_inserts() {
+    GrowableTable table(16);
+    const int n_threads = 4;
+    const size_t n_kmers = 200000;
+    std::vector<std::thread> threads;
+    std::vector<int> failed(n_threads, 0);
+    for (int tid = 0; tid < n_threads; tid++) {
+        threads.emplace_back([&, tid]() {
+            for (size_t i = tid; i < n_kmers; i += n_threads) {
+                kmer_pair kmer = make_kmer(i, "TA");
+                failed[tid] += !table.insert(kmer, kmer.kmer.hash(table.hasher));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (int tid = 0; tid < n_threads; tid++) {
+        CHECK(failed[tid] == 0);
+    }
+    CHECK(table.n_grows >= 10);
+    CHECK(table.size() == n_kmers);
+    for (size_t i = 0; i < n_kmers; i++) {
+        kmer_pair found;
+        CHECK(table.find(make_kmer(i).kmer, make_kmer(i).kmer.hash(table.hasher), found));
+        CHECK(found == make_kmer(i, "TA"));
+    }
+}
+
+int main() {
+    test_wire_entries();
+    test_group_counts();
+    test_probe_reaches_every_group<PairSlots>();
+    test_probe_reaches_every_group<SplitSlots>();
+    test_probe_reaches_every_group<EntrySlots>();
+    test_grow_and_migrate();
+    test_threaded_inserts();
+    return check_result();
+}
@@ -0,0 +1,99 @@
+#include <cctype>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "packing.hpp"
+
+// Every kernel set the CPU runs packs and unpacks like the scalar kernels,
+// one k-mer at a time and in bulk, at any stride.
+
+const size_t N_KMERS = 1000;
+
+// Text lines "<kmer> FF\n" with random bases, some of them lower case
+std::vector<char> random_lines(size_t line_len) {
+    std::vector<char> text(N_KMERS * line_len);
+    std::mt19937_64 rng(7);
+    for (size_t i = 0; i < N_KMERS; i++) {
+        char* line = &text[i * line_len];
+        for (int j = 0; j < KMER_LEN; j++) {
+            uint64_t r = rng();
+            line[j] = ((r >> 2) % 8 == 0 ? "acgt" : "ACGT")[r & 3];
+        }
+        memcpy(line + KMER_LEN, " FF\n", 4);
+    }
+    return text;
+}
+
+#if PACKING_VECTOR
+void test_kernels(int kernels) {
+    const size_t line_len = KMER_LEN + 4;
+    std::vector<char> text = random_lines(line_len);
+
+    // One k-mer at a time, then in bulk from the lines into records with a gap
+    const size_t packed_stride = PACKED_KMER_LEN + 3;
+    std::vector<unsigned char> scalar(N_KMERS * packed_stride, 0xAB);
+    std::vector<unsigned char> single(N_KMERS * packed_stride, 0xAB);
+    std::vector<unsigned char> bulk(N_KMERS * packed_stride, 0xAB);
+    for (size_t i = 0; i < N_KMERS; i++) {
+        packKmerScalar(&text[i * line_len], &scalar[i * packed_stride]);
+    }
+    for (size_t i = 0; i < N_KMERS; i++) {
+        if (kernels == PACKING_AVX2) {
+            packKmerAVX2(&text[i * line_len], &single[i * packed_stride]);
+        } else if (kernels == PACKING_SSSE3) {
+            packKmerSSSE3(&text[i * line_len], &single[i * packed_stride]);
+        }
+    }
+    if (kernels == PACKING_AVX2) {
+        packKmersAVX2(text.data(), line_len, N_KMERS, bulk.data(), packed_stride);
+    } else if (kernels == PACKING_SSSE3) {
+        packKmersSSSE3(text.data(), line_len, N_KMERS, bulk.data(), packed_stride);
+    }
+    CHECK(single == scalar);
+    CHECK(bulk == scalar);
+
+    // Unpacking writes upper case bases and nothing past each k-mer
+    const size_t stride = KMER_LEN + 2;
+    std::vector<char> unpacked(N_KMERS * stride, '.');
+    std::vector<char> unpacked_bulk(N_KMERS * stride, '.');
+    for (size_t i = 0; i < N_KMERS; i++) {
+        unpackKmerSSSE3(&scalar[i * packed_stride], &unpacked[i * stride]);
+    }
+    unpackKmersSSSE3(scalar.data(), packed_stride, N_KMERS, unpacked_bulk.data(), stride);
+    CHECK(unpacked == unpacked_bulk);
+    for (size_t i = 0; i < N_KMERS; i++) {
+        std::string expected(&text[i * line_len], KMER_LEN);
+        for (char& c : expected) {
+            c = toupper(c);
+        }
+        CHECK(std::string(&unpacked[i * stride], KMER_LEN) == expected);
+        CHECK(unpacked[i * stride + KMER_LEN] == '.' && unpacked[i * stride + KMER_LEN + 1] == '.');
+    }
+}
+#endif
+
+int main() {
+    printf("Kernels on this CPU: %s\n", packing_kernel_names[packing_kernels]);
+#if PACKING_VECTOR
+    for (int kernels = PACKING_SSSE3; kernels <= packing_kernels; kernels++) {
+        test_kernels(kernels);
+    }
+#endif
+
+    // The dispatching entry points agree with the scalar ones
+    std::vector<char> text = random_lines(KMER_LEN + 4);
+    unsigned char packed[PACKED_KMER_LEN], expected[PACKED_KMER_LEN];
+    char kmer[KMER_LEN], unpacked[KMER_LEN];
+    for (size_t i = 0; i < N_KMERS; i++) {
+        packKmer(&text[i * (KMER_LEN + 4)], packed);
+        packKmerScalar(&text[i * (KMER_LEN + 4)], expected);
+        CHECK(memcmp(packed, expected, PACKED_KMER_LEN) == 0);
+        unpackKmer(packed, kmer);
+        unpackKmerScalar(packed, unpacked);
+        CHECK(memcmp(kmer, unpacked, KMER_LEN) == 0);
+    }
+    return check_result();
+}
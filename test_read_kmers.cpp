@@ -0,0 +1,194 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "kmer_stream.hpp"
+#include "kmer_t.hpp"
+#include "read_kmers.hpp"
+#include "write_kmers.hpp"
+
+// Reading k-mer files: line endings, blank and short lines, binary and
+// block-compressed files, and the split of a file between ranks, through
+// every reader.
+
+// A k-mer line "<kmer> <fb>" whose bases depend on i
+std::string kmer_line(int i, const std::string& fb) {
+    std::string kmer;
+    for (int j = 0; j < KMER_LEN; j++) {
+        kmer += "ACGT"[(i * 7 + j * (j + i)) % 4];
+    }
+    return kmer + " " + fb;
+}
+
+kmer_pair line_kmer(const std::string& line) {
+    return kmer_pair(line.substr(0, KMER_LEN), line.substr(KMER_LEN + 1, 2));
+}
+
+std::vector<kmer_pair> parse(const std::string& text, size_t max_kmers = 1000) {
+    std::vector<kmer_pair> kmers(max_kmers);
+    size_t n;
+    const char* stop = parse_kmers(text.data(), text.data() + text.size(), kmers.data(),
+                                   max_kmers, n);
+    CHECK(stop <= text.data() + text.size());
+    kmers.resize(n);
+    return kmers;
+}
+
+void write_file(const std::string& fname, const std::string& text) {
+    FILE* f = fopen(fname.c_str(), "wb");
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+}
+
+void test_line_endings() {
+    std::string a = kmer_line(1, "FA"), b = kmer_line(2, "CG"), c = kmer_line(3, "TF");
+    std::vector<kmer_pair> expected = {line_kmer(a), line_kmer(b), line_kmer(c)};
+
+    CHECK(parse(a + "\n" + b + "\n" + c + "\n") == expected);
+    CHECK(parse(a + "\r\n" + b + "\r\n" + c + "\r\n") == expected);
+    CHECK(parse(a + "\n" + b + "\r\n" + c) == expected);
+    CHECK(parse(a + "\n" + b + "\n" + c + "\r") == expected);
+
+    // Blank lines anywhere are skipped, and never end up in a k-mer
+    CHECK(parse("\n" + a + "\n\n" + b + "\n\r\n" + c + "\n\n") == expected);
+    CHECK(parse(a + "\r\n\r\n" + b + "\n" + c + "\n\n\n").size() == 3);
+    CHECK(parse("").empty());
+    CHECK(parse("\n\r\n\n").empty());
+}
+
+void test_malformed_lines() {
+    std::string a = kmer_line(1, "FA"), b = kmer_line(2, "CG");
+
+    CHECK_THROWS(parse("ACGT F\n" + a + "\n"));
+    CHECK_THROWS(parse(a + "\nACGT F\n" + b + "\n"));
+    CHECK_THROWS(parse(a + "\n" + a.substr(0, KMER_LEN + 2) + "\n"));
+    CHECK_THROWS(parse(a + "\n" + a.substr(0, KMER_LEN)));
+    CHECK_THROWS(parse(a + "\n" + a.substr(0, KMER_LEN + 2) + "\r\n"));
+}
+
+void test_max_kmers() {
+    std::string text;
+    for (int i = 0; i < 10; i++) {
+        text += kmer_line(i, "AC") + (i % 2 ? "\r\n" : "\n\n");
+    }
+
+    // Parsing in pieces picks up where the last piece stopped
+    std::vector<kmer_pair> kmers(3);
+    const char* p = text.data();
+    const char* stop = text.data() + text.size();
+    for (int i = 0; i < 10;) {
+        size_t n;
+        p = parse_kmers(p, stop, kmers.data(), kmers.size(), n);
+        CHECK(n == std::min<size_t>(3, 10 - i));
+        for (size_t j = 0; j < n; j++, i++) {
+            CHECK(kmers[j] == line_kmer(kmer_line(i, "AC")));
+        }
+    }
+    size_t n;
+    parse_kmers(p, stop, kmers.data(), kmers.size(), n);
+    CHECK(n == 0);
+}
+
+// Every rank count splits fname into shares that hold each k-mer once,
+// through read_kmers and KmerStream
+void check_shares(const std::string& fname, const std::vector<kmer_pair>& expected) {
+    for (int nprocs : {1, 2, 3, 7, 64}) {
+        std::vector<kmer_pair> read, streamed;
+        for (int rank = 0; rank < nprocs; rank++) {
+            std::vector<kmer_pair> share = read_kmers(fname, nprocs, rank);
+            read.insert(read.end(), share.begin(), share.end());
+
+            KmerStream stream(fname, nprocs, rank);
+            std::vector<kmer_pair> chunk;
+            while (stream.next(chunk, []() {})) {
+                streamed.insert(streamed.end(), chunk.begin(), chunk.end());
+            }
+        }
+        CHECK(read == expected);
+        CHECK(streamed == expected);
+    }
+}
+
+void test_rank_split() {
+    std::string text;
+    std::vector<kmer_pair> expected;
+    for (int i = 0; i < 200; i++) {
+        std::string line = kmer_line(i, "GT");
+        expected.push_back(line_kmer(line));
+        text += line + (i % 3 == 0 ? "\r\n" : "\n") + (i % 7 == 0 ? "\n" : "");
+    }
+    std::string fname = "test_read_kmers_" + std::to_string(KMER_LEN) + ".txt";
+    write_file(fname, text);
+    check_shares(fname, expected);
+
+    // A malformed line reaches the stream's reader as an error
+    write_file(fname, kmer_line(0, "AA") + "\nACGT F\n");
+    CHECK_THROWS(read_kmers(fname));
+    KmerStream stream(fname);
+    std::vector<kmer_pair> chunk;
+    CHECK_THROWS(while (stream.next(chunk, []() {})) {});
+
+    remove(fname.c_str());
+}
+
+// Binary files give back what was written, split evenly between ranks,
+// and files cut short of their records throw
+void test_binary_files() {
+    std::vector<kmer_pair> kmers;
+    for (int i = 0; i < 200; i++) {
+        kmers.push_back(line_kmer(kmer_line(i, "CF")));
+    }
+    std::string fname = "test_read_kmers_" + std::to_string(KMER_LEN) + ".bin";
+    write_binary_kmers(fname, kmers);
+    CHECK(line_count(fname) == kmers.size());
+    check_shares(fname, kmers);
+
+    // A file cut short of its records
+    FILE* f = fopen(fname.c_str(), "rb");
+    std::string bytes(sizeof(KmerFileHeader) + 3 * sizeof(kmer_pair) + 1, '\0');
+    CHECK(fread(&bytes[0], 1, bytes.size(), f) == bytes.size());
+    fclose(f);
+    write_file(fname, bytes);
+    CHECK_THROWS(read_kmers(fname));
+    CHECK_THROWS(read_kmers(fname, 2, 1));
+    CHECK_THROWS(KmerStream(fname, 2, 0));
+
+    remove(fname.c_str());
+}
+
+// Block-compressed files give back the text's k-mers whatever the block
+// size, including blocks shorter than a line
+void test_kgz_files() {
+    std::string text;
+    std::vector<kmer_pair> expected;
+    for (int i = 0; i < 200; i++) {
+        std::string line = kmer_line(i, "TA");
+        expected.push_back(line_kmer(line));
+        text += line + (i % 5 == 0 ? "\r\n" : "\n") + (i % 11 == 0 ? "\n" : "");
+    }
+    text.pop_back();
+    std::string text_fname = "test_read_kmers_" + std::to_string(KMER_LEN) + ".txt";
+    std::string fname = "test_read_kmers_" + std::to_string(KMER_LEN) + ".kgz";
+    write_file(text_fname, text);
+
+    for (size_t block_bytes : {size_t(10), size_t(100), size_t(1000), size_t(KGZ_BLOCK_BYTES)}) {
+        KgzFooter footer = compress_kmers(text_fname, fname, block_bytes);
+        CHECK((footer.n_blocks == 1) == (block_bytes >= text.size()));
+        check_shares(fname, expected);
+        CHECK(kmer_size(fname) == KMER_LEN);
+    }
+
+    remove(text_fname.c_str());
+    remove(fname.c_str());
+}
+
+int main() {
+    test_line_endings();
+    test_malformed_lines();
+    test_max_kmers();
+    test_rank_split();
+    test_binary_files();
+    test_kgz_files();
+    return check_result();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "butil.hpp"
+
+// Threads per rank, taken from KMER_THREADS. More than one needs a UPC++
+// build with UPCXX_THREADMODE=par.
+int threads_per_rank() {
+    int n_threads = BUtil::env_int("KMER_THREADS", 1);
+    if (n_threads < 1) {
+        n_threads = 1;
+    }
+#if !UPCXX_BACKEND_GASNET_PAR
+    if (n_threads > 1) {
+        throw std::runtime_error("Error: KMER_THREADS > 1 needs UPC++ configured with "
+                                 "UPCXX_THREADMODE=par.");
+    }
+#endif
+    return n_threads;
+}
+
+// Run fn(thread_id) for thread_id in [0, n_threads). Thread 0 is the caller,
+// which holds the master persona, so it keeps serving incoming RPCs until the
+// workers are done. Workers communicate through their own default personas.
+// The first exception thrown by any thread is rethrown here.
+template <typename F> void run_on_threads(int n_threads, F fn) {
+    std::atomic<int> workers_done(0);
+    std::vector<std::exception_ptr> errors(n_threads);
+    std::vector<std::thread> workers;
+
+    for (int tid = 1; tid < n_threads; tid++) {
+        workers.emplace_back([&, tid]() {
+            try {
+                fn(tid);
+            } catch (...) {
+                errors[tid] = std::current_exception();
+            }
+            workers_done++;
+        });
+    }
+
+    try {
+        fn(0);
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+
+    while (workers_done.load() < n_threads - 1) {
+        upcxx::progress();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
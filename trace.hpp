@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "butil.hpp"
+
+// Phase and event tracing. With KMER_TRACE=1 in the environment every
+// thread records spans into its own buffer, and trace_dump() writes
+// trace_<rank>.json in the Chrome trace format, which Perfetto and
+// chrome://tracing open directly; load several ranks' files together to
+// see them side by side. Without it a span costs one test of a flag, and
+// building with -DKMER_TRACING=0 removes the spans altogether.
+#ifndef KMER_TRACING
+#define KMER_TRACING 1
+#endif
+
+// Events kept per thread; older ones are overwritten. Phases, of which
+// there are few, are all kept.
+#define TRACE_EVENTS (1 << 20)
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#if KMER_TRACING
+// Record the enclosing scope as a phase, or as a span in the ring; arg is
+// shown with the event
+#define TRACE_PHASE(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, 0, true)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, 0, false)
+#define TRACE_SPAN_ARG(name, arg) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, arg, false)
+#define TRACE_INSTANT(name, arg) trace_instant(name, arg)
+#else
+#define TRACE_PHASE(name) \
+    do {                  \
+    } while (0)
+#define TRACE_SPAN(name) \
+    do {                 \
+    } while (0)
+#define TRACE_SPAN_ARG(name, arg) \
+    do {                          \
+    } while (0)
+#define TRACE_INSTANT(name, arg) \
+    do {                         \
+    } while (0)
+#endif
+
+struct TraceEvent {
+    // A string literal
+    const char* name;
+    uint64_t start_ns;
+    // Instant events have no duration
+    int64_t duration_ns;
+    int64_t arg;
+};
+
+// One thread's phases, and its ring of other events
+struct TraceBuffer {
+    int thread_id;
+    std::vector<TraceEvent> phases;
+    std::vector<TraceEvent> events;
+    uint64_t n_recorded;
+
+    TraceBuffer(int thread_id) : thread_id(thread_id), events(TRACE_EVENTS), n_recorded(0) {}
+
+    void record(const TraceEvent& event, bool phase) {
+        if (phase) {
+            phases.push_back(event);
+            return;
+        }
+        events[n_recorded % TRACE_EVENTS] = event;
+        n_recorded++;
+    }
+};
+
+// Set once by trace_init(), before any thread records
+struct TraceState {
+    bool enabled = false;
+    std::chrono::steady_clock::time_point epoch;
+
+    // Every thread's buffer, kept past the thread's exit
+    std::mutex lock;
+    std::vector<std::unique_ptr<TraceBuffer>> threads;
+};
+
+TraceState& trace_state() {
+    static TraceState state;
+    return state;
+}
+
+inline bool trace_enabled() { return trace_state().enabled; }
+
+inline uint64_t trace_now() {
+    auto elapsed = std::chrono::steady_clock::now() - trace_state().epoch;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+// The calling thread's buffer
+TraceBuffer& trace_buffer() {
+    thread_local TraceBuffer* mine = nullptr;
+    if (mine == nullptr) {
+        TraceState& state = trace_state();
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.threads.emplace_back(new TraceBuffer(state.threads.size()));
+        mine = state.threads.back().get();
+    }
+    return *mine;
+}
+
+struct TraceSpan {
+    const char* name;
+    int64_t arg;
+    bool phase;
+    uint64_t start_ns;
+
+    TraceSpan(const char* name, int64_t arg, bool phase)
+        : name(name), arg(arg), phase(phase), start_ns(0) {
+        if (trace_enabled()) {
+            start_ns = trace_now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (trace_enabled()) {
+            trace_buffer().record({name, start_ns, int64_t(trace_now() - start_ns), arg}, phase);
+        }
+    }
+};
+
+inline void trace_instant(const char* name, int64_t arg) {
+    if (trace_enabled()) {
+        trace_buffer().record({name, trace_now(), -1, arg}, false);
+    }
+}
+
+void trace_write_event(FILE* f, int rank, int thread_id, const TraceEvent& event) {
+    fprintf(f, ",\n{\"name\": \"%s\", \"pid\": %d, \"tid\": %d, \"ts\": %.3lf, ", event.name, rank,
+            thread_id, event.start_ns / 1000.0);
+    if (event.duration_ns >= 0) {
+        fprintf(f, "\"ph\": \"X\", \"dur\": %.3lf, ", event.duration_ns / 1000.0);
+    } else {
+        fprintf(f, "\"ph\": \"i\", \"s\": \"t\", ");
+    }
+    fprintf(f, "\"args\": {\"arg\": %lld}}", (long long)event.arg);
+}
+
+// Collective. Reads KMER_TRACE and starts every rank's clock together, so
+// the ranks' traces line up to within a barrier.
+void trace_init() {
+    TraceState& state = trace_state();
+    state.enabled = KMER_TRACING && BUtil::env_int("KMER_TRACE", 0) != 0;
+    upcxx::barrier();
+    state.epoch = std::chrono::steady_clock::now();
+}
+
+// A barrier, traced as a phase so time spent waiting for other ranks shows
+void traced_barrier() {
+    TRACE_PHASE("barrier");
+    upcxx::barrier();
+}
+
+// Write this rank's events to trace_<rank>.json. Call once the other
+// threads have stopped recording.
+void trace_dump() {
+    TraceState& state = trace_state();
+    if (!state.enabled) {
+        return;
+    }
+    int rank = upcxx::rank_me();
+    std::string fname = "trace_" + std::to_string(rank) + ".json";
+    FILE* f = fopen(fname.c_str(), "w");
+    if (f == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", fname.c_str());
+        return;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": "
+               "\"rank %d\"}}",
+            rank, rank);
+
+    std::lock_guard<std::mutex> guard(state.lock);
+    for (const auto& thread : state.threads) {
+        for (const auto& phase : thread->phases) {
+            trace_write_event(f, rank, thread->thread_id, phase);
+        }
+
+        // Oldest first; a full ring starts at the slot written next
+        uint64_t n = std::min<uint64_t>(thread->n_recorded, TRACE_EVENTS);
+        for (uint64_t i = thread->n_recorded - n; i < thread->n_recorded; i++) {
+            trace_write_event(f, rank, thread->thread_id, thread->events[i % TRACE_EVENTS]);
+        }
+        if (thread->n_recorded > n) {
+            fprintf(stderr, "Rank %d thread %d: trace kept the last %zu of %zu events.\n", rank,
+                    thread->thread_id, (size_t)n, (size_t)thread->n_recorded);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+}
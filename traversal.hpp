@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdexcept>
+#include <upcxx/upcxx.hpp>
+#include <utility>
+#include <vector>
+
+#include "contig.hpp"
+#include "contig_writer.hpp"
+#include "counters.hpp"
+#include "kmer_run.hpp"
+#include "kmer_t.hpp"
+#include "trace.hpp"
+#include "work_queue.hpp"
+
+// Number of contigs walked concurrently by each rank
+#define MAX_WALKS_IN_FLIGHT 256
+
+// Bookkeeping shared by all walks of one traversal
+struct WalkState {
+    int in_flight = 0;
+    bool failed = false;
+    // Finished contigs are written here as they complete, if set
+    ContigWriter* output = nullptr;
+};
+
+// Append a found run to contig, or end the walk as failed
+bool extend_walk(Contig& contig, const kmer_run& run, WalkState& state) {
+    if (run.last.empty()) {
+        state.failed = true;
+        state.in_flight--;
+        return false;
+    }
+    contig.append(run.packed.data(), run.n_bases, run.last.unpack());
+    COUNT(counters().walk_steps += run.n_bases + 1);
+    return true;
+}
+
+// Extend a contig until it ends or its next k-mer lives on another rank.
+// Owned k-mers are followed in place; a remote lookup parks the walk and
+// its completion resumes it, so many walks can wait on the network at once.
+// Each lookup brings back the run of k-mers its owner holds in a row.
+template <typename Map>
+void advance_walk(Map& hashmap, Contig& contig, WalkState& state) {
+    while (contig.back().forwardExt() != 'F') {
+        upcxx::future<kmer_run> next = hashmap.find_run_async(contig.back().next_kmer());
+
+        if (!next.ready()) {
+            COUNT(counters().walk_waits++);
+            next.then([&hashmap, &contig, &state](const kmer_run& run) {
+                if (!extend_walk(contig, run, state)) {
+                    return;
+                }
+                // Only the first k-mer of a remote run cost a message
+                COUNT(counters().local_steps += run.n_bases);
+                advance_walk(hashmap, contig, state);
+            });
+            return;
+        }
+
+        const kmer_run& run = next.result();
+        if (!extend_walk(contig, run, state)) {
+            return;
+        }
+        COUNT(counters().local_steps += run.n_bases + 1);
+    }
+    if (state.output != nullptr) {
+        state.output->add(contig);
+        state.output->pump();
+    }
+    state.in_flight--;
+}
+
+// Assemble the contigs starting at the start nodes in queue, keeping up to
+// MAX_WALKS_IN_FLIGHT lookups outstanding. Once this rank's own start nodes
+// run out, more are stolen from other ranks while the last walks finish.
+// Contigs are also passed to output, if given, as they finish.
+template <typename Map>
+ContigSet traverse_async(Map& hashmap, WorkQueue& queue, ContigWriter* output = nullptr) {
+    ContigSet contigs;
+    WalkState state;
+    state.output = output;
+
+    std::vector<kmer_pair> batch;
+    while (queue.take(batch, TAKE_BATCH)) {
+        for (const auto& start_kmer : batch) {
+            Contig& contig = contigs.add(start_kmer);
+            COUNT(counters().walks++);
+
+            state.in_flight++;
+            advance_walk(hashmap, contig, state);
+
+            if (state.in_flight >= MAX_WALKS_IN_FLIGHT) {
+                TRACE_SPAN("wait for walks");
+                while (state.in_flight >= MAX_WALKS_IN_FLIGHT) {
+                    upcxx::progress();
+                }
+            }
+        }
+    }
+
+    TRACE_SPAN("drain walks");
+    while (state.in_flight > 0) {
+        upcxx::progress();
+    }
+    if (output != nullptr) {
+        output->wait_claims();
+    }
+
+    if (state.failed) {
+        throw std::runtime_error("Error: k-mer not found in hashmap.");
+    }
+    return contigs;
+}
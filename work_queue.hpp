@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <upcxx/upcxx.hpp>
+#include <vector>
+
+#include "counters.hpp"
+#include "kmer_t.hpp"
+#include "trace.hpp"
+
+// Start nodes a walker takes from its rank's queue at a time
+#define TAKE_BATCH 16
+
+// Most start nodes one steal moves
+#define STEAL_MAX 4096
+
+// The contig start nodes of one traversal, shared by a rank's threads and
+// stolen from by idle ranks, so a rank with a few long contigs hands the
+// rest of its start nodes to others. The owner takes from the back; a
+// thief takes half of what is left from the front.
+//
+// Start nodes are only ever moved, never created, so a rank that finds
+// every other queue empty in one pass stops looking: anything still moving
+// is walked by the rank that took it.
+struct WorkQueue {
+    std::mutex lock;
+    std::deque<kmer_pair> nodes;
+    bool stealing;
+    bool exhausted;
+    std::minstd_rand rng;
+
+    upcxx::dist_object<WorkQueue*> self;
+
+    // Collective. The queue must outlive every rank's traversal, so destroy
+    // it only after a barrier.
+    WorkQueue(const std::vector<kmer_pair>& start_nodes, bool stealing);
+
+    // Move up to n start nodes into batch, stealing once this rank has none
+    // left; false when no work was found anywhere. Not for completions.
+    bool take(std::vector<kmer_pair>& batch, size_t n);
+
+    // Move up to n start nodes from the back of this rank's queue
+    size_t take_local(std::vector<kmer_pair>& batch, size_t n);
+
+    // Ask victim for some of its start nodes, and hand them out there
+    std::vector<kmer_pair> steal(int victim);
+    std::vector<kmer_pair> give();
+};
+
+WorkQueue::WorkQueue(const std::vector<kmer_pair>& start_nodes, bool stealing)
+    : nodes(start_nodes.begin(), start_nodes.end()), stealing(stealing), exhausted(false),
+      rng(upcxx::rank_me() + 1), self(this) {}
+
+size_t WorkQueue::take_local(std::vector<kmer_pair>& batch, size_t n) {
+    std::lock_guard<std::mutex> guard(lock);
+    while (batch.size() < n && !nodes.empty()) {
+        batch.push_back(nodes.back());
+        nodes.pop_back();
+    }
+    return batch.size();
+}
+
+bool WorkQueue::take(std::vector<kmer_pair>& batch, size_t n) {
+    batch.clear();
+    if (take_local(batch, n) > 0) {
+        return true;
+    }
+
+    int n_ranks = upcxx::rank_n();
+    int first;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!stealing || exhausted || n_ranks == 1) {
+            return false;
+        }
+        first = rng() % n_ranks;
+    }
+
+    // One pass over the other ranks, from a random one so thieves spread out
+    for (int i = 0; i < n_ranks; i++) {
+        int victim = (first + i) % n_ranks;
+        if (victim == upcxx::rank_me()) {
+            continue;
+        }
+        std::vector<kmer_pair> stolen = steal(victim);
+        if (!stolen.empty()) {
+            COUNT(counters().steals++; counters().stolen += stolen.size());
+            std::lock_guard<std::mutex> guard(lock);
+            nodes.insert(nodes.end(), stolen.begin(), stolen.end());
+            break;
+        }
+    }
+
+    // Another thread of this rank may have stolen meanwhile
+    if (take_local(batch, n) > 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    exhausted = true;
+    return false;
+}
+
+std::vector<kmer_pair> WorkQueue::steal(int victim) {
+    TRACE_SPAN_ARG("steal", victim);
+    return upcxx::rpc(
+               victim, [](upcxx::dist_object<WorkQueue*>& queue) { return (*queue)->give(); },
+               self)
+        .wait();
+}
+
+std::vector<kmer_pair> WorkQueue::give() {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t n = std::min<size_t>((nodes.size() + 1) / 2, STEAL_MAX);
+    std::vector<kmer_pair> given(nodes.begin(), nodes.begin() + n);
+    nodes.erase(nodes.begin(), nodes.begin() + n);
+    return given;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "kmer_gzip.hpp"
+#include "kmer_t.hpp"
+#include "read_kmers.hpp"
+
+// Writers for the k-mer file formats read_kmers.hpp reads; kmer_convert
+// and the tests use them.
+
+// Write kmers to fname in the binary format
+void write_binary_kmers(const std::string& fname, const std::vector<kmer_pair>& kmers) {
+    KmerFileHeader header;
+    memcpy(header.magic, KMER_FILE_MAGIC, 8);
+    header.kmer_len = KMER_LEN;
+    header.record_size = sizeof(kmer_pair);
+    header.n_records = kmers.size();
+
+    FILE* f = fopen(fname.c_str(), "wb");
+    if (f == NULL) {
+        throw std::runtime_error("could not open " + fname);
+    }
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                   fwrite(kmers.data(), sizeof(kmer_pair), kmers.size(), f) == kmers.size();
+    if (fclose(f) != 0 || !written) {
+        throw std::runtime_error("could not write " + fname);
+    }
+}
+
+// Compress text_fname into blocks of whole lines of about block_bytes each,
+// then the index and footer, and return the footer
+KgzFooter compress_kmers(const std::string& text_fname, const std::string& out_fname,
+                         size_t block_bytes = KGZ_BLOCK_BYTES) {
+    MappedFile text(text_fname);
+    FILE* f = fopen(out_fname.c_str(), "wb");
+    if (f == NULL) {
+        throw std::runtime_error("could not open " + out_fname);
+    }
+
+    std::vector<KgzBlock> index;
+    uint64_t offset = 0, n_kmers = 0;
+    bool written = true;
+    const char* p = text.data;
+    const char* end = text.data + text.size;
+
+    while (p < end && written) {
+        // Cut after the last newline that fits, or the first one if none does
+        const char* cut = std::min(p + block_bytes, end);
+        if (cut < end) {
+            const char* line_end = cut;
+            while (line_end > p && line_end[-1] != '\n') {
+                line_end--;
+            }
+            cut = line_end > p ? line_end : std::min(find_newline(cut, end) + 1, end);
+        }
+
+        std::vector<char> packed = deflate_block(p, cut - p, Z_DEFAULT_COMPRESSION);
+        KgzBlock block;
+        block.offset = offset;
+        block.first_kmer = n_kmers;
+        block.size = packed.size();
+        block.raw_size = cut - p;
+        index.push_back(block);
+
+        written = fwrite(packed.data(), 1, packed.size(), f) == packed.size();
+        offset += packed.size();
+        n_kmers += count_newlines(p, cut) + (cut[-1] != '\n');
+        p = cut;
+    }
+
+    KgzFooter footer;
+    footer.index_offset = offset;
+    footer.n_blocks = index.size();
+    footer.n_kmers = n_kmers;
+    memcpy(footer.magic, KGZ_MAGIC, 8);
+
+    written = written && fwrite(index.data(), sizeof(KgzBlock), index.size(), f) == index.size() &&
+              fwrite(&footer, sizeof(footer), 1, f) == 1;
+    if (fclose(f) != 0 || !written) {
+        throw std::runtime_error("could not write " + out_fname);
+    }
+    return footer;
+}